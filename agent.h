@@ -11,6 +11,7 @@
 #include <string>
 #include <random>
 #include <sstream>
+#include <iomanip>
 #include <map>
 #include <type_traits>
 #include <algorithm>
@@ -18,6 +19,16 @@
 #include "action.h"
 #include <fstream>
 #include "mcts.h"
+#include "lockstep.h"
+#include "book.h"
+#include "solver.h"
+#include "bench.h"
+#include "dataset.h"
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <limits>
+#include <functional>
 
 #define RNG 0
 #define MCTS 1
@@ -38,6 +49,7 @@ public:
 	virtual void close_episode(const std::string& flag = "") {}
 	virtual action take_action(const board& b) { return action(); }
 	virtual bool check_for_win(const board& b) { return false; }
+	virtual size_t simulations() const { return 0; } // spent on the last action
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -71,6 +83,20 @@ protected:
 	std::default_random_engine engine;
 };
 
+/**
+ * the read-only resource loaded from the file, shared by all players of the process,
+ * e.g., one opening book for all the sessions of gtp_server
+ */
+template<class T>
+std::shared_ptr<T> shared_resource(const std::string& path) {
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<T>> loaded;
+	std::lock_guard<std::mutex> lock(mutex);
+	std::shared_ptr<T> resource = loaded[path].lock();
+	if (!resource) loaded[path] = resource = std::make_shared<T>(path);
+	return resource;
+}
+
 /**
  * random player for both side
  * put a legal piece randomly
@@ -102,6 +128,75 @@ public:
 				}
 				if (meta.find("RAVE") != meta.end())
 					RAVE = atof(meta["RAVE"].value.c_str());
+				if (meta.find("tree") != meta.end()) {
+					std::string kind = meta["tree"].value;
+					if (kind == "uct")          tree_kind = mcts::uct;
+					else if (kind == "rave")    tree_kind = mcts::uct_rave;
+					else if (kind == "puct")    tree_kind = mcts::puct;
+					else throw std::invalid_argument("invalid tree policy: " + kind);
+				}
+				if (meta.find("c") != meta.end())
+					exploration = atof(meta["c"].value.c_str());
+				if (meta.find("prior") != meta.end()) {
+					std::string kind = meta["prior"].value;
+					if (kind == "features")     priors = true;
+					else if (kind != "uniform") throw std::invalid_argument("invalid prior: " + kind);
+					if (priors && tree_kind == -1)
+						tree_kind = mcts::puct;
+				}
+				if (meta.find("fpu") != meta.end())
+					first_play_reduction = atof(meta["fpu"].value.c_str());
+				if (meta.find("root") != meta.end()) {
+					std::string kind = meta["root"].value;
+					if (kind == "halving")      shortlist = 16;
+					else if (kind != "policy")  throw std::invalid_argument("invalid root policy: " + kind);
+				}
+				if (shortlist && meta.find("shortlist") != meta.end())
+					shortlist = atoi(meta["shortlist"].value.c_str());
+				if (meta.find("solve") != meta.end())
+					solve_threshold = atoi(meta["solve"].value.c_str());
+				if (meta.find("solve_time") != meta.end())
+					solve_time = atoi(meta["solve_time"].value.c_str());
+				else
+					solve_time = mcts_sim_count ? std::numeric_limits<int>::max() : mcts_think_time / 2;
+				solve_nodes = size_t(mcts_sim_count) * solve_nodes_per_simulation; // 0 with a time budget
+				if (meta.find("playout") != meta.end() && meta["playout"].value == "pattern") {
+					if (meta.find("patterns") != meta.end())
+						patterns = shared_resource<pattern_table>(meta["patterns"].value);
+					else
+						patterns.reset(new pattern_table());
+					policy.patterns = patterns.get();
+				}
+				if (meta.find("race") != meta.end())
+					policy.race = atoi(meta["race"].value.c_str()) != 0;
+				if (meta.find("lgr") != meta.end())
+					policy.reply_depth = atoi(meta["lgr"].value.c_str());
+				if (meta.find("tree_mem") != meta.end())
+					tree_mem = parse_bytes(meta["tree_mem"].value);
+				if (meta.find("tree_gc") != meta.end())
+					tree_prune = (meta["tree_gc"].value != "freeze");
+				if (meta.find("eval") != meta.end()) {
+					std::string type = meta["eval"].value;
+					std::string weights = meta.find("eval_weights") != meta.end() ? meta["eval_weights"].value : "";
+					if (type == "rollout")
+						leaf_eval.reset(new rollout_evaluator(policy));
+					else if (type == "linear")
+						leaf_eval = weights.size() ? shared_resource<linear_evaluator>(weights) : std::make_shared<linear_evaluator>();
+					else if (type == "mlp")
+						leaf_eval = shared_resource<mlp_evaluator>(weights);
+					else if (type == "lockstep")
+						leaf_eval.reset(new lockstep_evaluator(engine()));
+					else
+						throw std::invalid_argument("invalid evaluator: " + type);
+				}
+				if (meta.find("batch") != meta.end())
+					eval_batch = atoi(meta["batch"].value.c_str());
+				if (meta.find("tree_load") != meta.end())
+					tree_load = meta["tree_load"].value;
+				if (meta.find("tree_save") != meta.end())
+					tree_save = meta["tree_save"].value;
+				if (meta.find("book") != meta.end())
+					opening = shared_resource<book>(meta["book"].value);
 			}
 			else if(meta["search"].value == "MORON") {
 				mode = MORON;
@@ -113,12 +208,39 @@ public:
 	}
 
 	virtual action take_action(const board& state) {
+		last_simulations = 0;
 		std::shuffle(space.begin(), space.end(), engine);
 		switch (mode) {
 			case MCTS:
 				{
-				mcts gameTree(state, who, mcts_sim_count, mcts_think_time, RAVE);
-				return gameTree.tree_search();
+				action::place move;
+				if (opening && opening->probe(state, who, move)) {
+					board after = state;
+					if (move.apply(after) == board::legal)
+						return move;
+				}
+				int think_time = mcts_think_time;
+				if (state.legal_moves(who) < solve_threshold) {
+					auto start = std::chrono::steady_clock::now();
+					if (endgame.solve(state, who, solve_time, move, solve_nodes) == solver::win) {
+						if (dataset)
+							dataset->add(state, who, { { move.position().i, 1 } }, 1);
+						return move;
+					}
+					auto spent = std::chrono::steady_clock::now() - start;
+					think_time = std::max<int>(1, think_time - std::chrono::duration_cast<std::chrono::milliseconds>(spent).count());
+				}
+				mcts gameTree(state, who, mcts_sim_count, think_time, RAVE, policy);
+				configure(gameTree);
+				if (tree_load.size())
+					gameTree.load(tree_path(tree_load, state));
+				move = gameTree.tree_search();
+				last_simulations = gameTree.simulation_count();
+				if (dataset)
+					dataset->add(state, who, gameTree.root_visits(), gameTree.root_value());
+				if (tree_save.size())
+					gameTree.save(tree_path(tree_save, state));
+				return move;
 				break;
 				}
 			case MORON:
@@ -133,6 +255,107 @@ public:
 		return action();
 	}
 
+	virtual size_t simulations() const { return last_simulations; }
+	size_t simulation_budget() const { return mcts_sim_count; } // per move, 0 if the search is timed
+
+	/**
+	 * search the position for this player until the flag is set, without playing a move
+	 * the hook is called with the tree every interval milliseconds
+	 */
+	void analyze(const board& state, const std::atomic<bool>& stop, int interval, std::function<void(const mcts&)> hook) {
+		mcts gameTree(state, who, 0, std::numeric_limits<int>::max(), RAVE, policy);
+		configure(gameTree);
+		gameTree.use_sequential_halving(0); // no budget to share between the phases
+		gameTree.stop_on(&stop);
+		gameTree.on_progress(interval, hook);
+		gameTree.tree_search();
+	}
+
+	/**
+	 * search the position by MCTS with the budget of this player, pass the finished tree to the hook, and return the move
+	 * unlike take_action(), the opening book and the endgame solver are not consulted
+	 * the progress hook, if any, is called with the tree every interval milliseconds during the search
+	 */
+	action::place search(const board& state, std::function<void(const mcts&)> done,
+	                     std::function<void(const mcts&)> progress = nullptr, int interval = 100) {
+		mcts gameTree(state, who, mcts_sim_count, mcts_think_time, RAVE, policy);
+		configure(gameTree);
+		if (progress)
+			gameTree.on_progress(interval, progress);
+		action::place move = gameTree.tree_search();
+		done(gameTree);
+		return move;
+	}
+
+	/**
+	 * stop the searches of this player as soon as the flag is set
+	 */
+	void stop_on(const std::atomic<bool>* flag) {
+		stop = flag;
+	}
+
+	/**
+	 * export a training sample of every searched move to the dataset
+	 */
+	void export_to(dataset_writer* data) {
+		dataset = data;
+	}
+
+	/**
+	 * build an opening book with the search settings of this player
+	 */
+	void build_book(const std::string& path, unsigned plies, unsigned width) {
+		book_builder(mcts_sim_count, mcts_think_time, RAVE).build(path, plies, width);
+	}
+
+	/**
+	 * benchmark the search settings of this player by self-play on the given geometry
+	 */
+	void benchmark(const std::string& geometry, size_t games) {
+		if (geometry == "7x7")          ::benchmark<board7x7>(games, mcts_sim_count, mcts_think_time, RAVE, policy);
+		else if (geometry == "9x9")     ::benchmark<board>(games, mcts_sim_count, mcts_think_time, RAVE, policy);
+		else if (geometry == "11x11")   ::benchmark<board11x11>(games, mcts_sim_count, mcts_think_time, RAVE, policy);
+		else throw std::invalid_argument("invalid geometry: " + geometry);
+	}
+
+private:
+	/**
+	 * apply the search settings of this player to the tree
+	 */
+	void configure(mcts& gameTree) {
+		gameTree.limit_memory(tree_mem, tree_prune);
+		if (tree_kind != -1 || exploration != 0)
+			gameTree.use_tree_policy(mcts::tree_policy(tree_kind != -1 ? tree_kind : RAVE != 0 ? mcts::uct_rave : mcts::uct), exploration);
+		if (leaf_eval)
+			gameTree.use_evaluator(leaf_eval.get(), eval_batch);
+		gameTree.use_sequential_halving(shortlist);
+		if (priors)
+			gameTree.use_priors(prior_features(), first_play_reduction);
+		gameTree.stop_on(stop);
+	}
+
+	/**
+	 * the tree file of the position in the directory, named by the position hash and the player to move
+	 */
+	std::string tree_path(const std::string& dir, const board& state) const {
+		std::stringstream name;
+		name << dir << '/' << std::hex << std::setw(16) << std::setfill('0') << state.hash() << '-' << "?bw"[who] << ".tree";
+		return name.str();
+	}
+
+	/**
+	 * parse a size such as "512M", with an optional suffix of K, M, or G
+	 */
+	static size_t parse_bytes(const std::string& text) {
+		size_t bytes = std::stoull(text);
+		switch (std::toupper(text.back())) {
+			case 'G': bytes <<= 10; // fall through
+			case 'M': bytes <<= 10; // fall through
+			case 'K': bytes <<= 10;
+		}
+		return bytes;
+	}
+
 private:
 	std::vector<action::place> space;
 	board::piece_type who;
@@ -140,4 +363,26 @@ private:
 	int mcts_sim_count = 0;
 	int mcts_think_time = 900;
 	double RAVE = 0.5;
+	int tree_kind = -1; // see mcts::tree_policy, by the RAVE weight if not set
+	double exploration = 0; // the exploration constant, the default of the tree policy if 0
+	size_t shortlist = 0; // candidates of sequential halving at the root, by the tree policy if 0
+	bool priors = false; // priors of the board features instead of uniform priors
+	double first_play_reduction = 0.25; // see puct_policy, explore all children first if < 0
+	std::shared_ptr<book> opening;
+	std::shared_ptr<pattern_table> patterns;
+	playout policy;
+	size_t tree_mem = 0; // memory limit of the search tree in bytes, 0 for unlimited
+	bool tree_prune = true;
+	std::shared_ptr<evaluator> leaf_eval; // rollouts by the tree search if not set
+	size_t eval_batch = 16;
+	dataset_writer* dataset = nullptr;
+	const std::atomic<bool>* stop = nullptr;
+	size_t last_simulations = 0;
+	std::string tree_load; // directory of trees to warm start from
+	std::string tree_save; // directory to save the trees after searches
+	solver endgame;
+	int solve_threshold = 0; // solve exactly when fewer legal moves remain, disabled if 0
+	int solve_time = 450;
+	size_t solve_nodes = 0; // the node limit of the solver with a count budget, 0 for unlimited
+	static constexpr size_t solve_nodes_per_simulation = 8; // a solver node costs a fraction of a simulation
 };
@@ -0,0 +1,103 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * analysis.h: Offline analysis of a corpus of positions by the workers of the scheduler
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "scheduler.h"
+
+/**
+ * the corpus is either episode records, one per line as saved by statistic, where every position
+ * before a move is analyzed (repeated positions only once), or board dumps as printed by board,
+ * where the player to move is decided by the number of stones
+ *
+ * each position is written as a line of
+ *   <index> <b|w> best <move> value <win rate of the player to move> visits <move>:<visits> ...
+ * in the order of the corpus
+ */
+class position_analysis {
+public:
+	/**
+	 * read the corpus, return the number of positions
+	 */
+	size_t load(std::istream& in) {
+		std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		size_t start = text.find_first_not_of(" \t\r\n");
+		if (start != std::string::npos && text[start] == '(') {
+			std::set<std::pair<uint64_t, unsigned>> seen;
+			std::stringstream lines(text);
+			for (std::string line; std::getline(lines, line); ) {
+				episode ep;
+				if (line.empty() || !ep.parse(text_range(line.data(), line.data() + line.size()))) continue;
+				board state;
+				for (const action& move : ep.actions()) {
+					board::piece_type who = state.info().who_take_turns;
+					if (seen.insert({ state.hash(), who }).second) add(state, who);
+					if (move.apply(state) != board::legal) break;
+				}
+			}
+		} else {
+			std::stringstream dumps(text);
+			for (board state; dumps >> state; state = board()) {
+				int stones[4] = { 0 };
+				for (int i = 0; i < board::size_x * board::size_y; i++) stones[state(i) & 3u]++;
+				add(state, stones[board::black] > stones[board::white] ? board::white : board::black);
+			}
+		}
+		return positions.size();
+	}
+
+	/**
+	 * search every position with the settings of the player args, as tasks of the shared scheduler
+	 * with a count budget, the results are reproducible by the seed
+	 */
+	void run(const std::string& args, unsigned seed) {
+		results.assign(positions.size(), "");
+		per_worker<player> black([&]() { return new player("name=analysis " + args + " role=black"); });
+		per_worker<player> white([&]() { return new player("name=analysis " + args + " role=white"); });
+		scheduler::shared().parallel_for(positions.size(), [&](size_t i) {
+			player& who = positions[i].second == board::black ? black.local() : white.local();
+			engine.seed(seed + i); // so that the result does not depend on the workers
+			std::iota(node::space().begin(), node::space().end(), 0);
+			who.search(positions[i].first, [&](const mcts& tree) { results[i] = report(i, tree); });
+		});
+	}
+
+	void write(std::ostream& out) const {
+		for (const std::string& line : results) out << line << std::endl;
+	}
+
+private:
+	void add(const board& state, board::piece_type who) {
+		positions.emplace_back(state, who);
+		positions.back().first.info(board::data{ who });
+	}
+
+	static std::string report(size_t index, const mcts& tree) {
+		const node& root = tree.root_node();
+		std::stringstream line;
+		line << index << ' ' << "?bw"[root.who] << " best ";
+		if (root.children.size()) line << std::string(root.best_action().position());
+		else line << "resign";
+		line << " value " << std::fixed << std::setprecision(4) << tree.root_value() << " visits";
+		for (const std::pair<int, int>& child : tree.root_visits())
+			line << ' ' << std::string(board::point(child.first)) << ':' << child.second;
+		return line.str();
+	}
+
+private:
+	std::vector<std::pair<board, board::piece_type>> positions;
+	std::vector<std::string> results;
+};
@@ -0,0 +1,48 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bench.h: Self-play benchmark of the search on boards of any geometry
+ */
+
+#pragma once
+#include <iostream>
+#include <chrono>
+#include "board.h"
+#include "action.h"
+#include "mcts.h"
+
+/**
+ * play games of MCTS against itself on a board of geometry B, and show the statistic
+ *
+ * the format would be
+ * 7x7 (1x1 hollow)  games = 100, win = 53%|47%, op = 36.12, sims = 1000 (25312/s)
+ *
+ * where 'sims' is the average simulations of a move, and its speed per second
+ */
+template<class B>
+void benchmark(size_t games, int cycles, int think_time, double RAVE, const playout& policy) {
+	size_t black_win = 0, moves = 0, sims = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t game = 0; game < games; game++) {
+		B state;
+		for (board::piece_type who = board::black; ; who = board::piece_type(3u - who)) {
+			basic_mcts<B> tree(state, who, cycles, think_time, RAVE, policy);
+			int pos = tree.tree_search().position().i;
+			sims += tree.simulation_count();
+			if (pos == -1 || state.place(typename B::point(pos), who) != board::legal) {
+				black_win += (who == board::white);
+				break;
+			}
+			moves++;
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << B::size_x << "x" << B::size_y << " (" << B::hollow_x << "x" << B::hollow_y << " hollow)\t";
+	std::cout << "games = " << games << ", ";
+	std::cout << "win = " << (black_win * 100.0 / games) << "%"
+	          <<      "|" << ((games - black_win) * 100.0 / games) << "%, ";
+	std::cout << "op = " << (moves * 1.0 / games) << ", ";
+	std::cout << "sims = " << (sims * 1.0 / std::max<size_t>(moves, 1))
+	          <<     " (" << (sims / elapsed) << "/s)";
+	std::cout << std::endl;
+}
@@ -9,7 +9,8 @@
 
 #pragma once
 #include <array>
-#include <list>
+#include <string>
+#include <cstdint>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
@@ -41,24 +42,80 @@
  *
  * for 9x9 Hollow NoGo, the center 3x3 is hollow (hollow but not empty, cannot be counted as liberty),
  * i.e., there are also borders at the center of the board
+ *
+ * other geometries are instances of basic_board<size_x, size_y, hollow_x, hollow_y>,
+ * e.g., board7x7 and board11x11
  */
-class board {
-public:
-	enum size { size_x = 9u, size_y = 9u, hollow_x = 3u, hollow_y = 3u };
+/**
+ * types shared by the boards of all geometries
+ */
+struct board_base {
 	enum piece_type { empty = 0u, black = 1u, white = 2u, hollow = 3u, unknown = -1u };
 	typedef uint32_t cell;
-	typedef std::array<cell, size_y> column;
-	typedef std::array<column, size_x> grid;
 	struct data {
 		piece_type who_take_turns;
 	};
 	typedef int reward;
 
+	enum nogo_move_result {
+		legal = reward(0),
+		illegal_turn = reward(-1),
+		illegal_pass = reward(-2),
+		illegal_out_of_range = reward(-3),
+		illegal_not_empty = reward(-4),
+		illegal_suicide = reward(-5),
+		illegal_take = reward(-6),
+	};
+};
+
+template<int... I> struct index_list {};
+template<int N, int... I> struct make_index_list : make_index_list<N - 1, N - 1, I...> {};
+template<int... I> struct make_index_list<0, I...> { typedef index_list<I...> type; };
+
+/**
+ * neighbor tables of a geometry, generated at compile time
+ * a neighbor beyond the edge or inside the hollow is the border, i.e., the sentinel cell W * H,
+ * which is always hollow, so that no bound needs to be checked when walking the board
+ */
+template<unsigned W, unsigned H, unsigned HW, unsigned HH>
+struct board_geometry {
+	int adjacent[W * H][4]; // left, right, down, up
+	int around[W * H][8];   // the 3x3 neighborhood without the center, row by row (see pattern.h)
+	board_base::cell initial[W * H + 1];
+
+	static constexpr bool in_hollow(int x, int y) {
+		return x >= int(W - HW) / 2 && x < int(W - HW) / 2 + int(HW) && y >= int(H - HH) / 2 && y < int(H - HH) / 2 + int(HH);
+	}
+	static constexpr bool on_board(int x, int y) {
+		return x >= 0 && x < int(W) && y >= 0 && y < int(H) && !in_hollow(x, y);
+	}
+	static constexpr int neighbor(int i, int dx, int dy) {
+		return on_board(i / int(H) + dx, i % int(H) + dy) ? (i / int(H) + dx) * int(H) + (i % int(H) + dy) : int(W * H);
+	}
+	template<int... I>
+	static constexpr board_geometry generate(index_list<I...>) {
+		return board_geometry{
+			{ { neighbor(I, -1, 0), neighbor(I, 1, 0), neighbor(I, 0, -1), neighbor(I, 0, 1) }... },
+			{ { neighbor(I, -1, -1), neighbor(I, 0, -1), neighbor(I, 1, -1), neighbor(I, -1, 0),
+			    neighbor(I, 1, 0), neighbor(I, -1, 1), neighbor(I, 0, 1), neighbor(I, 1, 1) }... },
+			{ (in_hollow(I / int(H), I % int(H)) ? board_base::hollow : board_base::empty)..., board_base::hollow } };
+	}
+};
+
+template<unsigned W, unsigned H, unsigned HW, unsigned HH>
+class basic_board : public board_base {
+public:
+	enum size { size_x = W, size_y = H, hollow_x = HW, hollow_y = HH };
+	enum { cells = W * H, border = W * H }; // border is the sentinel cell
+	typedef std::array<cell, W * H + 1> grid;
+	typedef board_geometry<W, H, HW, HH> geometry;
+	static constexpr geometry table = geometry::generate(typename make_index_list<W * H>::type());
+
 public:
-	board() : stone(initial()), attr({piece_type::black}) {}
-	board(const grid& b, const data& d) : stone(b), attr(d) {}
-	board(const board& b) = default;
-	board& operator =(const board& b) = default;
+	basic_board() : stone(initial()), attr({piece_type::black}) {}
+	basic_board(const grid& b, const data& d) : stone(b), attr(d) {}
+	basic_board(const basic_board& b) = default;
+	basic_board& operator =(const basic_board& b) = default;
 
 	struct point {
 		int x, y, i;
@@ -78,35 +135,25 @@ public:
 
 	operator grid&() { return stone; }
 	operator const grid&() const { return stone; }
-	column& operator [](unsigned x) { return stone[x]; }
-	const column& operator [](unsigned x) const { return stone[x]; }
-	cell& operator ()(unsigned i) { point p(i); return stone[p.x][p.y]; }
-	const cell& operator ()(unsigned i) const { point p(i); return stone[p.x][p.y]; }
-	cell& operator ()(const std::string& move) { point p(move); return stone[p.x][p.y]; }
-	const cell& operator ()(const std::string& move) const { point p(move); return stone[p.x][p.y]; }
+	cell* operator [](unsigned x) { return &stone[x * size_y]; }
+	const cell* operator [](unsigned x) const { return &stone[x * size_y]; }
+	cell& operator ()(unsigned i) { return stone[i]; }
+	const cell& operator ()(unsigned i) const { return stone[i]; }
+	cell& operator ()(const std::string& move) { return stone[point(move).i]; }
+	const cell& operator ()(const std::string& move) const { return stone[point(move).i]; }
 
 	data info() const { return attr; }
 	data info(data dat) { data old = attr; attr = dat; return old; }
 
 public:
-	bool operator ==(const board& b) const { return stone == b.stone; }
-	bool operator < (const board& b) const { return stone <  b.stone; }
-	bool operator !=(const board& b) const { return !(*this == b); }
-	bool operator > (const board& b) const { return b < *this; }
-	bool operator <=(const board& b) const { return !(b < *this); }
-	bool operator >=(const board& b) const { return !(*this < b); }
+	bool operator ==(const basic_board& b) const { return stone == b.stone; }
+	bool operator < (const basic_board& b) const { return stone <  b.stone; }
+	bool operator !=(const basic_board& b) const { return !(*this == b); }
+	bool operator > (const basic_board& b) const { return b < *this; }
+	bool operator <=(const basic_board& b) const { return !(b < *this); }
+	bool operator >=(const basic_board& b) const { return !(*this < b); }
 
 public:
-	enum nogo_move_result {
-		legal = reward(0),
-		illegal_turn = reward(-1),
-		illegal_pass = reward(-2),
-		illegal_out_of_range = reward(-3),
-		illegal_not_empty = reward(-4),
-		illegal_suicide = reward(-5),
-		illegal_take = reward(-6),
-	};
-
 	/**
 	 * place a stone to the specific position
 	 * who == piece_type::unknown indicates automatically play as the next side
@@ -116,20 +163,23 @@ public:
 		if (who == -1u) who = attr.who_take_turns;
 		if (who != attr.who_take_turns) return nogo_move_result::illegal_turn;
 		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
-		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
-		if (board::initial()[x][y] == piece_type::hollow)             return nogo_move_result::illegal_out_of_range;
-		board test = *this;
-		if (test[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
-		test[x][y] = who; // try put a piece first
-		if (test.check_liberty(x, y, who) == 0) return nogo_move_result::illegal_suicide;
+		if (x < 0 || x >= size_x || y < 0 || y >= size_y) return nogo_move_result::illegal_out_of_range;
+		int i = x * size_y + y;
+		if (table.initial[i] == piece_type::hollow)   return nogo_move_result::illegal_out_of_range;
+		if (stone[i] != piece_type::empty) return nogo_move_result::illegal_not_empty;
+		stone[i] = who; // try put a piece first
 		unsigned opp = 3u - who;
-		if (x > p_min.x && test.check_liberty(x - 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (x < p_max.x && test.check_liberty(x + 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (y > p_min.y && test.check_liberty(x, y - 1, opp) == 0) return nogo_move_result::illegal_take;
-		if (y < p_max.y && test.check_liberty(x, y + 1, opp) == 0) return nogo_move_result::illegal_take;
-		stone[x][y] = who; // is legal move!
-		attr.who_take_turns = static_cast<piece_type>(opp);
+		reward result = nogo_move_result::legal;
+		if (!breathe(i, who)) result = nogo_move_result::illegal_suicide;
+		for (int d = 0; d < 4 && result == nogo_move_result::legal; d++) {
+			int j = table.adjacent[i][d];
+			if (stone[j] == opp && !breathe(j, opp)) result = nogo_move_result::illegal_take;
+		}
+		if (result != nogo_move_result::legal) {
+			stone[i] = piece_type::empty;
+			return result;
+		}
+		attr.who_take_turns = static_cast<piece_type>(opp); // is legal move!
 		return nogo_move_result::legal;
 	}
 	reward place(const point& p, unsigned who = piece_type::unknown) {
@@ -141,40 +191,125 @@ public:
 	 * return >= 0 if [x][y] is placed by who; otherwise return -1
 	 */
 	int check_liberty(int x, int y, unsigned who) const {
-		grid test = stone;
-		if (test[x][y] != who) return -1;
+		int i = point(x, y).i;
+		if (stone[i] != who) return -1;
 
-		int liberty = 0;
-		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
-			int x = check.front().x, y = check.front().y;
-			test[x][y] = piece_type::unknown; // prevent recalculate
+		int liberty = 0, top = 0;
+		std::array<bool, cells + 1> check{};
+		std::array<int, cells> stack;
+		for (check[i] = true, stack[top++] = i; top; ) {
+			int p = stack[--top];
+			for (int q : table.adjacent[p]) {
+				if (check[q]) continue;
+				if (stone[q] == piece_type::empty) liberty++, check[q] = true;
+				else if (stone[q] == who) stack[top++] = q, check[q] = true;
+			}
+		}
+		return liberty;
+	}
 
-			point p_min(0, 0), p_max(size_x - 1, size_y - 1);
+	/**
+	 * return true if the block of piece at i has any liberty, stop at the first one found
+	 */
+	bool breathe(int i, unsigned who) const {
+		int top = 0;
+		std::array<bool, cells + 1> check{};
+		std::array<int, cells> stack;
+		for (check[i] = true, stack[top++] = i; top; ) {
+			int p = stack[--top];
+			for (int q : table.adjacent[p]) {
+				if (stone[q] == piece_type::empty) return true;
+				if (stone[q] == who && !check[q]) stack[top++] = q, check[q] = true;
+			}
+		}
+		return false;
+	}
 
-			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
-			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
+	/**
+	 * collect the legal positions of who into moves (if given), and return the number of them
+	 * all blocks are labeled once with their liberties, instead of trying every position by place()
+	 */
+	int legal_moves(unsigned who, int* moves = nullptr) const {
+		std::array<int, cells + 1> block, mark, liberty;
+		std::array<int, cells> stack;
+		block.fill(border);
+		mark.fill(-1);
+		liberty[border] = 0;
+		for (int i = 0; i < cells; i++) {
+			if (block[i] != border || (stone[i] != piece_type::black && stone[i] != piece_type::white)) continue;
+			int libs = 0, top = 0;
+			block[i] = i;
+			for (stack[top++] = i; top; ) {
+				int p = stack[--top];
+				for (int q : table.adjacent[p]) {
+					if (stone[q] == piece_type::empty && mark[q] != i) {
+						mark[q] = i;
+						libs++;
+					} else if (stone[q] == stone[i] && block[q] == border) {
+						block[q] = i;
+						stack[top++] = q;
+					}
+				}
+			}
+			liberty[i] = libs;
+		}
 
-			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
-			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
+		int count = 0;
+		for (int i = 0; i < cells; i++) {
+			if (stone[i] != piece_type::empty) continue;
+			bool breath = false, take = false;
+			for (int q : table.adjacent[i]) {
+				if (stone[q] == piece_type::empty) breath = true;
+				else if (stone[q] == who) breath |= liberty[block[q]] > 1;
+				else if (stone[q] == 3u - who) take |= liberty[block[q]] == 1;
+			}
+			if (breath && !take) {
+				if (moves) moves[count] = i;
+				count++;
+			}
+		}
+		return count;
+	}
 
-			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
-			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
+	/**
+	 * return the number of moves who can surely still play, whatever the opponent does
+	 * an eye (empty position surrounded only by own stones and borders) is illegal for the opponent forever,
+	 * and blocks connected through e eyes can always fill e - 1 of them without suicide
+	 */
+	int safe_moves(unsigned who) const {
+		std::array<int, cells> root, eyes;
+		for (int i = 0; i < cells; i++) root[i] = i, eyes[i] = 0;
+		auto find = [&](int i) { while (root[i] != i) i = root[i] = root[root[i]]; return i; };
+		auto join = [&](int a, int b) { a = find(a), b = find(b); if (a != b) root[a] = b, eyes[b] += eyes[a]; };
 
-			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
-			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
+		for (int i = 0; i < cells; i++) {
+			if (stone[i] != who) continue;
+			int right = table.adjacent[i][1], up = table.adjacent[i][3];
+			if (stone[right] == who) join(i, right);
+			if (stone[up] == who) join(i, up);
 		}
-		return liberty;
+		for (int i = 0; i < cells; i++) {
+			if (stone[i] != piece_type::empty) continue;
+			int own = -1;
+			bool eye = true;
+			for (int q : table.adjacent[i]) {
+				if (stone[q] == piece_type::hollow) continue;
+				if (stone[q] != who) eye = false;
+				else if (own == -1) own = q;
+				else join(own, q);
+			}
+			if (eye && own != -1) eyes[find(own)]++;
+		}
+		int count = 0;
+		for (int i = 0; i < cells; i++)
+			if (root[i] == i && eyes[i] > 1) count += eyes[i] - 1;
+		return count;
 	}
 
 	void transpose() {
 		for (int x = 0; x < size_x; x++) {
 			for (int y = x + 1; y < size_y; y++) {
-				std::swap(stone[x][y], stone[y][x]);
+				std::swap((*this)[x][y], (*this)[y][x]);
 			}
 		}
 	}
@@ -182,7 +317,7 @@ public:
 	void reflect_horizontal() {
 		for (int y = 0; y < size_y; y++) {
 			for (int x = 0; x < size_x / 2; x++) {
-				std::swap(stone[x][y], stone[size_x - 1 - x][y]);
+				std::swap((*this)[x][y], (*this)[size_x - 1 - x][y]);
 			}
 		}
 	}
@@ -190,7 +325,7 @@ public:
 	void reflect_vertical() {
 		for (int x = 0; x < size_x; x++) {
 			for (int y = 0; y < size_y / 2; y++) {
-				std::swap(stone[x][y], stone[x][size_y - 1 - y]);
+				std::swap((*this)[x][y], (*this)[x][size_y - 1 - y]);
 			}
 		}
 	}
@@ -212,8 +347,34 @@ public:
 	void rotate_left() { transpose(); reflect_horizontal(); } // counterclockwise
 	void reverse() { reflect_horizontal(); reflect_vertical(); }
 
+	/**
+	 * zobrist key of a piece at the 1-d position i
+	 * empty and hollow cells have no key, so hash() only depends on the stones
+	 */
+	static uint64_t zobrist(unsigned i, cell type) {
+		static const std::array<uint64_t, cells * 2> keys = []() {
+			std::array<uint64_t, cells * 2> keys;
+			uint64_t seed = 0x9e3779b97f4a7c15ull;
+			for (uint64_t& key : keys) { // splitmix64
+				uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				key = z ^ (z >> 31);
+			}
+			return keys;
+		}();
+		return (type == piece_type::black || type == piece_type::white) ? keys[i * 2 + type - 1] : 0;
+	}
+
+	uint64_t hash() const {
+		uint64_t h = 0;
+		for (int i = 0; i < cells; i++)
+			h ^= zobrist(i, stone[i]);
+		return h;
+	}
+
 public:
-	friend std::ostream& operator <<(std::ostream& out, const board& b) {
+	friend std::ostream& operator <<(std::ostream& out, const basic_board& b) {
 		std::ios ff(nullptr);
 		ff.copyfmt(out); // make a copy of the original print format
 
@@ -242,7 +403,7 @@ public:
 		out.copyfmt(ff); // restore print format
 		return out;
 	}
-	friend std::istream& operator >>(std::istream& in, board& b) {
+	friend std::istream& operator >>(std::istream& in, basic_board& b) {
 		std::string token;
 		for (int x = 0; x < size_x; x++) in >> token; /* skip X */
 		for (int y = size_y - 1; y >= 0 && in >> token /* skip Y */; in >> token /* skip Y */, y--) {
@@ -273,15 +434,22 @@ public:
 	}
 
 protected:
-	static const grid& initial() { static grid stone; return stone; }
-	static __attribute__((constructor)) void init_initial_scheme() {
-		grid& stone = const_cast<grid&>(initial());
-		point hollow((size_x - hollow_x) / 2, (size_y - hollow_y) / 2);
-		for (int x = hollow.x; x < hollow.x + hollow_x; x++)
-			for (int y = hollow.y; y < hollow.y + hollow_y; y++)
-				stone[x][y] = piece_type::hollow;
+	static const grid& initial() {
+		static const grid stone = []() {
+			grid stone;
+			std::copy(table.initial, table.initial + cells + 1, stone.begin());
+			return stone;
+		}();
+		return stone;
 	}
 private:
 	grid stone;
 	data attr;
 };
+
+template<unsigned W, unsigned H, unsigned HW, unsigned HH>
+constexpr board_geometry<W, H, HW, HH> basic_board<W, H, HW, HH>::table;
+
+typedef basic_board<9, 9, 3, 3> board;
+typedef basic_board<7, 7, 1, 1> board7x7;
+typedef basic_board<11, 11, 3, 3> board11x11;
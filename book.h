@@ -0,0 +1,217 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * book.h: Memory-mapped opening book built from offline MCTS searches
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "action.h"
+#include "mcts.h"
+
+/**
+ * the book file is a single open-addressing hash table
+ *
+ *   header | entry[capacity]
+ *
+ * keys are canonical over the 8 symmetries of the board (the hollow is symmetric),
+ * and the move of each entry is stored in the canonical orientation
+ */
+class book {
+public:
+	struct header {
+		char magic[8];
+		uint32_t version;
+		uint32_t capacity; // power of 2
+		uint32_t count;
+		uint32_t plies;
+	};
+	struct entry {
+		uint64_t key;  // 0 for an empty slot
+		int16_t move;  // canonical 1-d position
+		uint16_t ply;
+		uint32_t visits;
+	};
+
+	static constexpr uint32_t version = 1;
+
+public:
+	book(const std::string& path) : path(path), base(nullptr), length(0), table(nullptr), mask(0) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1) throw std::invalid_argument("invalid book: " + path);
+		struct stat st;
+		if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(header)) {
+			length = st.st_size;
+			base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		if (base == MAP_FAILED || base == nullptr) throw std::invalid_argument("invalid book: " + path);
+		const header& head = *static_cast<const header*>(base);
+		if (std::memcmp(head.magic, "NOGOBOOK", 8) != 0 || head.version != version
+				|| head.capacity == 0 || (head.capacity & (head.capacity - 1)) != 0
+				|| length < sizeof(header) + head.capacity * sizeof(entry)) {
+			munmap(base, length);
+			throw std::invalid_argument("invalid book: " + path);
+		}
+		table = reinterpret_cast<const entry*>(static_cast<const char*>(base) + sizeof(header));
+		mask = head.capacity - 1;
+	}
+	~book() {
+		if (base) munmap(base, length);
+	}
+	book(const book&) = delete;
+	book& operator =(const book&) = delete;
+
+public:
+	/**
+	 * look up the position, return true and the move (in the orientation of state) if found
+	 */
+	bool probe(const board& state, board::piece_type who, action::place& move) const {
+		int sym;
+		uint64_t k = key(state, who, sym);
+		for (uint32_t i = k & mask; table[i].key != 0; i = (i + 1) & mask) {
+			if (table[i].key != k) continue;
+			move = action::place(transform(table[i].move, sym, true), who);
+			return true;
+		}
+		return false;
+	}
+
+	size_t size() const { return static_cast<const header*>(base)->count; }
+
+public:
+	/**
+	 * map the 1-d position i through symmetry s (or back, if inverse)
+	 * bit 0 of s transposes, bit 1 reflects x, bit 2 reflects y
+	 */
+	static int transform(int i, int s, bool inverse = false) {
+		board::point p(i);
+		int x = p.x, y = p.y;
+		if (inverse) {
+			if (s & 4) y = board::size_y - 1 - y;
+			if (s & 2) x = board::size_x - 1 - x;
+			if (s & 1) std::swap(x, y);
+		} else {
+			if (s & 1) std::swap(x, y);
+			if (s & 2) x = board::size_x - 1 - x;
+			if (s & 4) y = board::size_y - 1 - y;
+		}
+		return board::point(x, y).i;
+	}
+
+	/**
+	 * the canonical key of the position, i.e., the minimum key over all symmetries
+	 * sym is set to the symmetry which maps state to its canonical orientation
+	 */
+	static uint64_t key(const board& state, board::piece_type who, int& sym) {
+		uint64_t best = -1ull;
+		sym = 0;
+		for (int s = 0; s < 8; s++) {
+			uint64_t h = who == board::white ? 0x5bd1e9955bd1e995ull : 0;
+			for (int i = 0; i < board::size_x * board::size_y; i++)
+				h ^= board::zobrist(transform(i, s), state(i));
+			h = h ? h : 1;
+			if (h < best) {
+				best = h;
+				sym = s;
+			}
+		}
+		return best;
+	}
+
+	/**
+	 * write the entries as a book file, with the table at most half full
+	 */
+	static void save(const std::string& path, const std::vector<entry>& entries, uint32_t plies) {
+		uint32_t capacity = 1;
+		while (capacity < entries.size() * 2) capacity <<= 1;
+		std::vector<entry> table(capacity);
+		std::memset(table.data(), 0, capacity * sizeof(entry));
+		for (const entry& e : entries) {
+			uint32_t i = e.key & (capacity - 1);
+			while (table[i].key != 0 && table[i].key != e.key) i = (i + 1) & (capacity - 1);
+			table[i] = e;
+		}
+		header head;
+		std::memset(&head, 0, sizeof(head));
+		std::memcpy(head.magic, "NOGOBOOK", 8);
+		head.version = version;
+		head.capacity = capacity;
+		head.count = entries.size();
+		head.plies = plies;
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.write(reinterpret_cast<const char*>(table.data()), capacity * sizeof(entry));
+		if (!out) throw std::runtime_error("cannot write book: " + path);
+	}
+
+private:
+	std::string path;
+	void* base;
+	size_t length;
+	const entry* table;
+	uint32_t mask;
+};
+
+/**
+ * offline book builder
+ * searches every position of the first 'plies' plies, and expands the 'width' most visited
+ * replies of each search, i.e., the most popular lines
+ */
+class book_builder {
+public:
+	book_builder(int cycles, int think_time, double RAVE) : cycles(cycles), think_time(think_time), RAVE(RAVE) {}
+
+	void build(const std::string& path, unsigned plies, unsigned width) {
+		std::map<uint64_t, book::entry> entries;
+		std::vector<board> frontier(1);
+		for (unsigned ply = 0; ply < plies && frontier.size(); ply++) {
+			std::vector<board> next;
+			for (const board& state : frontier) {
+				board::piece_type who = state.info().who_take_turns;
+				int sym;
+				uint64_t key = book::key(state, who, sym);
+				if (entries.count(key)) continue;
+
+				mcts tree(state, who, cycles, think_time, RAVE);
+				action::place best = tree.tree_search();
+				if (best.position().i == -1) continue;
+
+				std::vector<const node*> replies(tree.root_node().children.begin(), tree.root_node().children.end());
+				std::sort(replies.begin(), replies.end(), [](const node* a, const node* b) { return a->N > b->N; });
+				book::entry& e = entries[key];
+				e.key = key;
+				e.move = book::transform(best.position().i, sym);
+				e.ply = ply;
+				e.visits = replies.size() ? replies.front()->N : 0;
+				for (size_t i = 0; i < replies.size() && i < width; i++)
+					next.push_back(replies[i]->current);
+
+				std::cerr << "book: ply " << ply << ", " << entries.size() << " positions, "
+				          << best << " (" << e.visits << " visits)" << std::endl;
+			}
+			frontier.swap(next);
+		}
+
+		std::vector<book::entry> table;
+		for (const auto& e : entries) table.push_back(e.second);
+		book::save(path, table, plies);
+	}
+
+private:
+	int cycles;
+	int think_time;
+	double RAVE;
+};
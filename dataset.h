@@ -0,0 +1,147 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * dataset.h: Streaming export of training samples from self-play
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "board.h"
+
+/**
+ * the dataset file is a sequence of chunks, so that files can be concatenated
+ *
+ *   chunk header | sample | sample | ... | chunk header | sample | ...
+ *
+ * each sample is a position and the search result at it:
+ *   uint8 who, int8 result (+1 if who won the game, -1 if lost), uint8 n, float value (of the root, for who)
+ *   uint8 stones[(cells + 3) / 4] (2 bits per point in 1-d order, low bits first, 3 for hollow)
+ *   n * { uint8 move, uint32 visits } (the visit distribution over the children of the root)
+ * all numbers are little-endian
+ */
+class dataset_writer {
+public:
+	struct chunk {
+		char magic[8];
+		uint32_t version;
+		uint32_t cells;
+		uint32_t samples;
+		uint32_t bytes; // size of the samples following the header
+	};
+
+	static constexpr uint32_t version = 1;
+
+	dataset_writer(const std::string& path, size_t chunk_samples = 1024)
+		: out(path, std::ios::out | std::ios::binary | std::ios::trunc), chunk_samples(chunk_samples), done(false) {
+		if (!out) throw std::invalid_argument("invalid dataset: " + path);
+		writer = std::thread(&dataset_writer::write_chunks, this);
+	}
+	~dataset_writer() {
+		if (samples) enqueue();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+		}
+		ready.notify_one();
+		writer.join();
+	}
+	dataset_writer(const dataset_writer&) = delete;
+	dataset_writer& operator =(const dataset_writer&) = delete;
+
+public:
+	/**
+	 * add a sample of the ongoing game, the result is filled when the game is closed
+	 */
+	void add(const board& state, board::piece_type who, const std::vector<std::pair<int, int>>& visits, double value) {
+		game.emplace_back();
+		std::string& s = game.back();
+		s.push_back(char(who));
+		s.push_back(0);
+		s.push_back(char(visits.size()));
+		float v = value;
+		s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+		const int cells = board::size_x * board::size_y;
+		for (int i = 0; i < cells; i += 4) {
+			uint8_t packed = 0;
+			for (int k = 0; k < 4 && i + k < cells; k++) packed |= (state(i + k) & 3u) << (k * 2);
+			s.push_back(char(packed));
+		}
+		for (const std::pair<int, int>& child : visits) {
+			uint32_t n = child.second;
+			s.push_back(char(child.first));
+			s.append(reinterpret_cast<const char*>(&n), sizeof(n));
+		}
+	}
+
+	/**
+	 * fill the results of the samples of the game, and pass them to the writer
+	 */
+	void close_game(board::piece_type winner) {
+		for (std::string& s : game) {
+			s[1] = char(s[0] == char(winner) ? 1 : -1);
+			buffer += s;
+			samples++;
+		}
+		game.clear();
+		if (samples >= chunk_samples) enqueue();
+	}
+
+private:
+	void enqueue() {
+		chunk head;
+		std::memset(&head, 0, sizeof(head));
+		std::memcpy(head.magic, "NOGODATA", 8);
+		head.version = version;
+		head.cells = board::size_x * board::size_y;
+		head.samples = samples;
+		head.bytes = buffer.size();
+		std::string data(reinterpret_cast<const char*>(&head), sizeof(head));
+		data += buffer;
+		buffer.clear();
+		samples = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(data));
+		}
+		ready.notify_one();
+	}
+
+	/**
+	 * the writer thread, so that the search is never blocked by the disk
+	 */
+	void write_chunks() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			ready.wait(lock, [this]() { return queue.size() || done; });
+			if (queue.empty()) break;
+			std::string data = std::move(queue.front());
+			queue.pop_front();
+			lock.unlock();
+			out.write(data.data(), data.size());
+			out.flush();
+			lock.lock();
+		}
+	}
+
+private:
+	std::ofstream out;
+	size_t chunk_samples;
+	std::vector<std::string> game;
+	std::string buffer;
+	size_t samples = 0;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::deque<std::string> queue;
+	bool done;
+};
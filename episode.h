@@ -18,13 +18,14 @@
 #include "board.h"
 #include "action.h"
 #include "agent.h"
+#include "record.h"
 
 class statistic;
 
 class episode {
 friend class statistic;
 public:
-	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {
+	episode() : ep_state(initial_state()), ep_score(0) {
 		ep_moves.reserve(board::size_x * board::size_y);
 	}
 
@@ -39,15 +40,22 @@ public:
 	void close_episode(const std::string& tag) {
 		ep_close = { tag, millisec() };
 	}
-	bool apply_action(action move) {
+	/**
+	 * apply the move, with the simulations spent on it if searched
+	 * the latency is measured since take_turns() by the steady clock in microseconds
+	 */
+	bool apply_action(action move, size_t sims = 0) {
 		board::reward reward = move.apply(state());
 		if (reward != board::legal) return false;
-		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		time_t micros = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - ep_time).count();
+		ep_moves.emplace_back(move, reward, micros / 1000);
+		ep_moves.back().micros = micros;
+		ep_moves.back().sims = sims;
 		ep_score += reward;
 		return true;
 	}
 	agent& take_turns(agent& black, agent& white) {
-		ep_time = millisec();
+		ep_time = clock::now();
 		return (step() % 2) ? white : black;
 	}
 	agent& last_turns(agent& black, agent& white) {
@@ -149,12 +157,39 @@ public:
 		return in;
 	}
 
-protected:
+	/**
+	 * parse a record written by operator <<, from a line of text which may be memory-mapped,
+	 * decoding the moves in place; return false (with an empty episode) if it is not a record
+	 */
+	bool parse(text_range line) {
+		*this = {};
+		text_range token(line.first, std::find(line.first, line.last, ')'));
+		const char* p = token.find("C[TCG|");
+		if (p == token.last) return false;
+		p += 6; // C[TCG|
+		if (!parse_meta(p, token.last, ep_open)) return true;
+		if (p != token.last) p++; // |
+		if (!parse_meta(p, token.last, ep_close)) return true;
+		p = std::find(p, token.last, ';');
+		while (token.last - p >= 6 && *p == ';') { // ;B[aa]
+			unsigned who = (p[1] == 'B') ? board::black : (p[1] == 'W') ? board::white : board::empty;
+			ep_moves.emplace_back(action::place(p[3] - 'a', (board::size_y - 1) - (p[4] - 'a'), who));
+			p += 6;
+			if (p != token.last && *p == 'C') { // C[time]
+				p = std::min(p + 2, token.last);
+				if (parse_number(p, token.last, ep_moves.back().time) && p != token.last) p++;
+			}
+		}
+		return true;
+	}
 
+protected:
 	struct move {
 		action code;
 		board::reward reward;
 		time_t time;
+		time_t micros = 0; // latency in microseconds, not saved
+		size_t sims = 0;   // simulations spent on the move, not saved
 		move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
 
 		operator action() const { return code; }
@@ -189,9 +224,20 @@ protected:
 		}
 	};
 
+	/**
+	 * parse a meta as "tag@when", as its operator >>
+	 */
+	static bool parse_meta(const char*& p, const char* last, meta& m) {
+		const char* at = std::find(p, last, '@');
+		m.tag.assign(p, at);
+		p = (at != last) ? at + 1 : last;
+		return parse_number(p, last, m.when);
+	}
+
 	static board initial_state() {
 		return {};
 	}
+	typedef std::chrono::steady_clock clock;
 	static time_t millisec() {
 		auto now = std::chrono::system_clock::now().time_since_epoch();
 		return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
@@ -201,7 +247,7 @@ private:
 	board ep_state;
 	board::reward ep_score;
 	std::vector<move> ep_moves;
-	time_t ep_time;
+	clock::time_point ep_time;
 
 	meta ep_open;
 	meta ep_close;
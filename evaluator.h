@@ -0,0 +1,185 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * evaluator.h: Leaf evaluators for the tree search, scoring positions in batches
+ */
+
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+#include "board.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * evaluate a batch of positions collected by the tree search, for the player to move in each position
+ * an evaluator may score the batch as a whole, or position by position
+ * the value is the probability to win, in [0, 1]
+ */
+template<class B>
+class basic_evaluator {
+public:
+	virtual ~basic_evaluator() {}
+	virtual void evaluate(const B* states, const board::piece_type* who, size_t n, float* values) = 0;
+};
+
+/**
+ * logistic regression over the move counts of both players
+ *   value = sigmoid(w0 + w1 * (legal - opp legal) + w2 * (safe - opp safe) + w3 * (legal + opp legal))
+ * where the counts are the legal and safe moves of the player to move and of the opponent
+ * since the player without legal moves loses, the move counts approximate the final race
+ */
+template<class B>
+class basic_linear_evaluator : public basic_evaluator<B> {
+public:
+	enum { features = 4 };
+
+	basic_linear_evaluator() : weights{{ -0.3f, 0.4f, 0.6f, 0.0f }} {}
+
+	/**
+	 * load the weights from a file of whitespace separated numbers, in the order of the features
+	 */
+	basic_linear_evaluator(const std::string& path) {
+		std::ifstream in(path);
+		for (float& w : weights)
+			if (!(in >> w)) throw std::invalid_argument("invalid linear weights: " + path);
+	}
+
+	virtual void evaluate(const B* states, const board::piece_type* who, size_t n, float* values) {
+		for (size_t i = 0; i < n; i++) {
+			board::piece_type opp = board::piece_type(3u - who[i]);
+			int legal = states[i].legal_moves(who[i]), opp_legal = states[i].legal_moves(opp);
+			int safe = states[i].safe_moves(who[i]), opp_safe = states[i].safe_moves(opp);
+			float z = weights[0] + weights[1] * (legal - opp_legal) + weights[2] * (safe - opp_safe)
+			        + weights[3] * (legal + opp_legal);
+			values[i] = 1 / (1 + std::exp(-z));
+		}
+	}
+
+private:
+	std::array<float, features> weights;
+};
+
+/**
+ * multilayer perceptron with one hidden layer of ReLU units and a sigmoid output
+ * the inputs are 4 planes of the board: own stones, opponent stones, own legal moves, opponent legal moves
+ *
+ * the weight file is text, as
+ *   mlp <inputs> <hidden>
+ *   W1[inputs][hidden] b1[hidden] W2[hidden] b2
+ * the inputs must be 4 * B::cells
+ */
+template<class B>
+class basic_mlp_evaluator : public basic_evaluator<B> {
+public:
+	enum { inputs = 4 * B::cells };
+
+	basic_mlp_evaluator(const std::string& path) {
+		std::ifstream in(path);
+		std::string magic;
+		size_t n = 0;
+		if (!(in >> magic >> n >> hidden) || magic != "mlp" || n != inputs || hidden == 0)
+			throw std::invalid_argument("invalid mlp weights: " + path);
+		stride = (hidden + 7) & ~size_t(7);
+		W1.assign(inputs * stride, 0);
+		b1.assign(stride, 0);
+		W2.assign(stride, 0);
+		for (size_t i = 0; i < inputs; i++)
+			for (size_t h = 0; h < hidden; h++) in >> W1[i * stride + h];
+		for (size_t h = 0; h < hidden; h++) in >> b1[h];
+		for (size_t h = 0; h < hidden; h++) in >> W2[h];
+		if (!(in >> b2)) throw std::invalid_argument("invalid mlp weights: " + path);
+	}
+
+	/**
+	 * the inputs are binary, so the hidden layer of a position is the sum of the rows of W1 at its active inputs
+	 * the positions of the batch are evaluated one at a time, since the sparse sums are bound by the loads and stores
+	 * of the hidden layer, and summing the whole batch row by row of W1 measured no faster
+	 */
+	virtual void evaluate(const B* states, const board::piece_type* who, size_t n, float* values) {
+		std::vector<float> act(stride);
+		int active[inputs];
+		for (size_t i = 0; i < n; i++) {
+			int count = encode(states[i], who[i], active);
+			act.assign(b1.begin(), b1.end());
+			for (int k = 0; k < count; k++) axpy(&W1[active[k] * stride], act.data(), stride);
+			float z = b2 + relu_dot(act.data(), W2.data(), stride);
+			values[i] = 1 / (1 + std::exp(-z));
+		}
+	}
+
+private:
+	/**
+	 * list the active inputs of the position for who, return the number of active inputs
+	 */
+	static int encode(const B& state, board::piece_type who, int* active) {
+		board::piece_type opp = board::piece_type(3u - who);
+		int count = 0;
+		for (int p = 0; p < B::cells; p++) {
+			if (state(p) == who)            active[count++] = p;
+			else if (state(p) == opp)       active[count++] = B::cells + p;
+		}
+		int moves[B::cells];
+		int legal = state.legal_moves(who, moves);
+		for (int k = 0; k < legal; k++)     active[count++] = 2 * B::cells + moves[k];
+		legal = state.legal_moves(opp, moves);
+		for (int k = 0; k < legal; k++)     active[count++] = 3 * B::cells + moves[k];
+		return count;
+	}
+
+	/**
+	 * y += x, with n a multiple of 8
+	 */
+	static void axpy(const float* x, float* y, size_t n) {
+		size_t i = 0;
+#if defined(__AVX2__)
+		for (; i + 8 <= n; i += 8)
+			_mm256_storeu_ps(y + i, _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+#elif defined(__SSE2__)
+		for (; i + 4 <= n; i += 4)
+			_mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+#endif
+		for (; i < n; i++) y[i] += x[i];
+	}
+
+	/**
+	 * return the dot product of relu(x) and w, with n a multiple of 8
+	 */
+	static float relu_dot(const float* x, const float* w, size_t n) {
+		float sum = 0;
+		size_t i = 0;
+#if defined(__AVX2__)
+		__m256 acc = _mm256_setzero_ps(), zero = _mm256_setzero_ps();
+		for (; i + 8 <= n; i += 8)
+			acc = _mm256_add_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_loadu_ps(x + i), zero), _mm256_loadu_ps(w + i)), acc);
+		float lane[8];
+		_mm256_storeu_ps(lane, acc);
+		for (float v : lane) sum += v;
+#elif defined(__SSE2__)
+		__m128 acc = _mm_setzero_ps(), zero = _mm_setzero_ps();
+		for (; i + 4 <= n; i += 4)
+			acc = _mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_loadu_ps(x + i), zero), _mm_loadu_ps(w + i)), acc);
+		float lane[4];
+		_mm_storeu_ps(lane, acc);
+		for (float v : lane) sum += v;
+#endif
+		for (; i < n; i++) sum += std::max(x[i], 0.0f) * w[i];
+		return sum;
+	}
+
+private:
+	size_t hidden = 0;
+	size_t stride = 0; // hidden padded to a multiple of 8
+	std::vector<float> W1, b1, W2;
+	float b2 = 0;
+};
+
+typedef basic_evaluator<board> evaluator;
+typedef basic_linear_evaluator<board> linear_evaluator;
+typedef basic_mlp_evaluator<board> mlp_evaluator;
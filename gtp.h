@@ -0,0 +1,294 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * gtp.h: GTP shell with the search running beside the command reader
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistic.h"
+
+/**
+ * the commands are read while genmove or lz-analyze is searching, so that
+ *   stop           ends the search, i.e., genmove replies its best move so far, or the analysis ends
+ * any other command waits for genmove to finish, or ends the analysis first
+ *
+ *   lz-analyze [color] [interval]
+ * replies "=" at once and then streams a line every interval centiseconds, as
+ *   info move E5 visits 120 winrate 5123 order 0 pv E5 F6 info move ...
+ * where winrate is in 1/10000 for the color, until the analysis ends with an empty line
+ * the color (by default the player to move) is analyzed as if it is to move
+ */
+class gtp_shell {
+public:
+	gtp_shell(statistic& stat, player& black, player& white, const std::string& name, const std::string& version)
+		: stat(stat), black(black), white(white), name(name), version(version), stop(false), running(idle), analysis(nullptr) {
+		black.stop_on(&stop);
+		white.stop_on(&stop);
+	}
+	~gtp_shell() {
+		halt();
+		black.stop_on(nullptr);
+		white.stop_on(nullptr);
+	}
+
+	/**
+	 * run until quit, the end of input, or an error which terminates the shell
+	 */
+	void run(std::istream& in, std::ostream& out) {
+		for (std::string line; std::getline(in, line) && command(line, out); );
+		wait();
+	}
+
+	/**
+	 * execute a command line, return false if the shell should terminate
+	 */
+	bool command(std::string line, std::ostream& out) {
+		if (line.size() && line.back() == '\r') line.pop_back();
+		if (line.empty()) return true;
+
+		std::vector<std::string> args;
+		std::istringstream iss(line);
+		for (std::string s; getline(iss, s, ' '); args.push_back(s));
+
+		if (args[0] == "stop") { // end the running search, and wait for its reply
+			halt();
+			respond(out, "");
+			return true;
+		}
+		if (analysis) halt();
+		else wait();
+		return execute(args, out);
+	}
+
+	/**
+	 * end the running search as the command line would, without waiting for it
+	 * for a reader on another thread, when the commands are executed in order elsewhere
+	 */
+	void interrupt(const std::string& line) {
+		if (interrupts(running, line)) stop = true;
+	}
+
+	/**
+	 * run the searches of genmove and lz-analyze in place, i.e., command() returns after the search
+	 * so that the commands of the shell can be executed by a pool of threads, see gtp_server
+	 * the queued hook tells whether any line queued after the command (or the end of input) passes the test,
+	 * so that a line interrupting the search is not lost if it is queued before the search starts
+	 */
+	void search_in_place(bool enable, std::function<bool(const std::function<bool(const std::string&)>&)> queued = nullptr) {
+		in_place = enable;
+		pending = queued;
+	}
+
+private:
+	/**
+	 * execute a command, return false if the shell should terminate
+	 */
+	bool execute(const std::vector<std::string>& args, std::ostream& out) {
+		std::string reply;
+		if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
+			if (!stat.is_episode_ongoing()) { // should open an episode
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				stat.open_episode(black.name() + ":" + white.name());
+			}
+
+			episode& game = stat.back();
+			agent& who = game.take_turns(black, white);
+			if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
+				respond(out, "resign");
+				// show the error message and terminate the shell
+				std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
+				std::cerr << "current state, "
+				          << who.role() << " to play: " << std::endl << game.state();
+				return false;
+			}
+			if (args[0] == "play") { // play a move
+				std::string types = "?bw"; // black == 1, white == 2
+				action::place move(args[2], types.find(who.role()[0]));
+				if (game.apply_action(move) != true) { // remote plays an illegal move?!
+					respond(out, "resign");
+					// show the error message and terminate the shell
+					std::cerr << who.role() << " plays an illegal action!" << std::endl;
+					const char* reason[] = {
+						"legal",
+						"illegal_turn",
+						"illegal_pass",
+						"illegal_out_of_range",
+						"illegal_not_empty",
+						"illegal_suicide",
+						"illegal_take",
+						"unknown",
+					};
+					std::cerr << "current state: " << std::endl << game.state();
+					int code = move.apply(game.state());
+					std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
+					std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
+					return false;
+				}
+			} else if (args[0] == "genmove") { // generate a move and play, replied by the search thread
+				start(generating, [this, &game, &who, &out]() {
+					action::place move = who.take_action(game.state());
+					if (game.apply_action(move, who.simulations()) == true) {
+						respond(out, move.position());
+					} else { // I have no legal move to play
+						respond(out, "resign");
+					}
+				});
+				return true;
+			}
+
+		} else if (args[0] == "lz-analyze") { // stream the analysis of the position until stopped
+			board state = stat.is_episode_ongoing() ? stat.back().state() : board();
+			player* who = (state.info().who_take_turns == board::white) ? &white : &black;
+			int interval = 100;
+			for (size_t i = 1; i < args.size(); i++) {
+				if (std::isdigit(args[i][0])) interval = std::stoi(args[i]);
+				else if (std::tolower(args[i][0]) == 'b') who = &black;
+				else if (std::tolower(args[i][0]) == 'w') who = &white;
+			}
+			state.info(board::data{ who == &white ? board::white : board::black }); // as if the color is to move
+			{
+				std::lock_guard<std::mutex> lock(output);
+				out << "=" << std::endl;
+			}
+			analysis = &out;
+			start(analyzing, [this, state, who, interval, &out]() {
+				who->analyze(state, stop, interval * 10, [this, &out](const mcts& tree) { report(out, tree); });
+			});
+			return true;
+
+		} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
+			if (stat.is_episode_ongoing()) { // should close an opened episode
+				agent& win = stat.back().last_turns(black, white);
+				stat.close_episode(win.name());
+				black.close_episode(win.name());
+				white.close_episode(win.name());
+			}
+			if (args[0] == "quit") return false; // quit GTP shell
+
+		} else if (args[0] == "showboard") { // print the board
+			std::stringstream buf;
+			buf << (stat.is_episode_ongoing() ? stat.back().state() : board());
+			reply = "\n" + buf.str();
+			reply.pop_back(); // remove a new line
+
+		} else if (args[0] == "boardsize") { // set the board size
+			size_t size = std::stoul(args[1]);
+			if (size != board::size_x || size != board::size_y) {
+				std::cerr << "board size mismatch: " << args[1] << std::endl;
+			}
+			if (size > board::size_x || size > board::size_y) return false;
+
+		} else if (args[0] == "name") { // report the name of the program
+			reply = name;
+		} else if (args[0] == "version") { // report the version number of the program
+			reply = version;
+		} else if (args[0] == "protocol_version") { // report GTP protocol version
+			reply = "2";
+		} else if (args[0] == "list_commands") { // print supported commands
+			reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
+			        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n"
+			        "lz-analyze\n" "stop\n";
+		} else {
+			reply = "unknown command";
+		}
+
+		respond(out, reply);
+		return true;
+	}
+
+	/**
+	 * write a line of the candidates at the root, ordered by visits
+	 */
+	void report(std::ostream& out, const mcts& tree) {
+		std::vector<const node*> children(tree.root_node().children.begin(), tree.root_node().children.end());
+		std::stable_sort(children.begin(), children.end(), [](const node* a, const node* b) { return a->N > b->N; });
+		std::stringstream line;
+		for (size_t order = 0; order < children.size() && children[order]->N > 0; order++) {
+			const node* child = children[order];
+			if (order) line << ' ';
+			line << "info move " << std::string(board::point(child->parent_move))
+			     << " visits " << child->N
+			     << " winrate " << int(child->value() * 10000)
+			     << " order " << order << " pv";
+			for (int move : child->principal_variation()) line << ' ' << std::string(board::point(move));
+		}
+		std::lock_guard<std::mutex> lock(output);
+		out << line.str() << std::endl;
+	}
+
+	void respond(std::ostream& out, const std::string& reply) {
+		std::lock_guard<std::mutex> lock(output);
+		out << "= " << reply << std::endl << std::endl;
+	}
+
+	/**
+	 * run the search beside the command reader, or in place
+	 */
+	void start(int kind, std::function<void()> search_task) {
+		stop = false;
+		running = kind;
+		if (in_place) {
+			if (pending && pending([kind](const std::string& line) { return interrupts(kind, line); })) stop = true;
+			search_task();
+			running = idle;
+			wait();
+		} else {
+			search = std::thread([this, search_task]() { search_task(); running = idle; });
+		}
+	}
+
+	/**
+	 * return true if the command line ends the search of the kind, see interrupt()
+	 */
+	static bool interrupts(int search, const std::string& line) {
+		return search == analyzing || (search == generating && line.compare(0, 4, "stop") == 0);
+	}
+
+	/**
+	 * wait for the running search, if any
+	 */
+	void wait() {
+		if (search.joinable()) search.join();
+		if (analysis) {
+			*analysis << std::endl; // end of the analysis
+			analysis = nullptr;
+		}
+	}
+
+	/**
+	 * stop the running search, and wait for it
+	 */
+	void halt() {
+		stop = true;
+		wait();
+	}
+
+private:
+	statistic& stat;
+	player& black;
+	player& white;
+	std::string name;
+	std::string version;
+
+	enum { idle, generating, analyzing };
+	std::thread search;
+	std::atomic<bool> stop;
+	std::atomic<int> running; // the kind of the running search
+	std::ostream* analysis; // the output of the running analysis, if any
+	std::mutex output;
+	bool in_place = false;
+	std::function<bool(const std::function<bool(const std::string&)>&)> pending; // see search_in_place()
+};
@@ -0,0 +1,374 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * lockstep.h: Random rollouts of a batch of positions in lockstep, over the SIMD lanes of bitboards
+ */
+
+#pragma once
+#include <array>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include "board.h"
+#include "evaluator.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * 16 lanes of 16 bits, e.g., the same row of 16 boards
+ * a lane mask is 0xffff in the selected lanes and 0 in the others
+ * without AVX2 the lanes are a plain array, which the compiler vectorizes as it can
+ */
+struct lanes16 {
+#if defined(__AVX2__)
+	__m256i v;
+#else
+	std::array<uint16_t, 16> v;
+#endif
+
+	static lanes16 fill(uint16_t x) {
+		lanes16 r;
+#if defined(__AVX2__)
+		r.v = _mm256_set1_epi16(x);
+#else
+		r.v.fill(x);
+#endif
+		return r;
+	}
+
+	uint16_t get(int lane) const {
+		uint16_t x[16];
+		std::memcpy(x, &v, sizeof(x));
+		return x[lane];
+	}
+	void set(int lane, uint16_t value) {
+		uint16_t x[16];
+		std::memcpy(x, &v, sizeof(x));
+		x[lane] = value;
+		std::memcpy(&v, x, sizeof(x));
+	}
+
+	/**
+	 * return true if any lane is nonzero
+	 */
+	bool any() const {
+#if defined(__AVX2__)
+		return !_mm256_testz_si256(v, v);
+#else
+		uint16_t x = 0;
+		for (uint16_t y : v) x |= y;
+		return x != 0;
+#endif
+	}
+};
+
+#if defined(__AVX2__)
+#define LANES16_OP(name, avx, scalar) \
+	inline lanes16 name(const lanes16& a, const lanes16& b) { lanes16 r; r.v = avx(a.v, b.v); return r; }
+#else
+#define LANES16_OP(name, avx, scalar) \
+	inline lanes16 name(const lanes16& a, const lanes16& b) { \
+		lanes16 r; \
+		for (int l = 0; l < 16; l++) { uint16_t x = a.v[l], y = b.v[l]; r.v[l] = (scalar); } \
+		return r; \
+	}
+#endif
+LANES16_OP(operator &, _mm256_and_si256, x & y)
+LANES16_OP(operator |, _mm256_or_si256, x | y)
+LANES16_OP(operator ^, _mm256_xor_si256, x ^ y)
+LANES16_OP(operator +, _mm256_add_epi16, x + y)
+LANES16_OP(operator -, _mm256_sub_epi16, x - y)
+LANES16_OP(eq, _mm256_cmpeq_epi16, x == y ? 0xffff : 0)
+LANES16_OP(gt, _mm256_cmpgt_epi16, int16_t(x) > int16_t(y) ? 0xffff : 0) // as signed
+LANES16_OP(mulhi, _mm256_mulhi_epu16, (uint32_t(x) * y) >> 16) // as unsigned
+#undef LANES16_OP
+
+/**
+ * a & ~b
+ */
+inline lanes16 without(const lanes16& a, const lanes16& b) {
+	lanes16 r;
+#if defined(__AVX2__)
+	r.v = _mm256_andnot_si256(b.v, a.v);
+#else
+	for (int l = 0; l < 16; l++) r.v[l] = a.v[l] & ~b.v[l];
+#endif
+	return r;
+}
+
+/**
+ * mask ? a : b, by lanes
+ */
+inline lanes16 select(const lanes16& mask, const lanes16& a, const lanes16& b) {
+	lanes16 r;
+#if defined(__AVX2__)
+	r.v = _mm256_blendv_epi8(b.v, a.v, mask.v);
+#else
+	for (int l = 0; l < 16; l++) r.v[l] = (a.v[l] & mask.v[l]) | (b.v[l] & ~mask.v[l]);
+#endif
+	return r;
+}
+
+template<int n>
+inline lanes16 shl(const lanes16& a) {
+	lanes16 r;
+#if defined(__AVX2__)
+	r.v = _mm256_slli_epi16(a.v, n);
+#else
+	for (int l = 0; l < 16; l++) r.v[l] = a.v[l] << n;
+#endif
+	return r;
+}
+
+template<int n>
+inline lanes16 shr(const lanes16& a) {
+	lanes16 r;
+#if defined(__AVX2__)
+	r.v = _mm256_srli_epi16(a.v, n);
+#else
+	for (int l = 0; l < 16; l++) r.v[l] = a.v[l] >> n;
+#endif
+	return r;
+}
+
+/**
+ * the number of set bits of each lane, by a lookup of nibbles
+ */
+inline lanes16 popcount(const lanes16& a) {
+	lanes16 r;
+#if defined(__AVX2__)
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+	                                     0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(a.v, low)),
+	                                _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(a.v, 4), low)));
+	r.v = _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0xff)), _mm256_srli_epi16(bytes, 8));
+#else
+	for (int l = 0; l < 16; l++) r.v[l] = __builtin_popcount(a.v[l]);
+#endif
+	return r;
+}
+
+/**
+ * play random rollouts of the positions in lockstep, one position per lane
+ * a board is a bitboard of rows, so the same row of 16 boards is a lanes16, and a ply of all lanes
+ * (picking a random candidate, and testing its liberty and captures by flood fills) is done by lane ops
+ * a lane which finishes its playout is refilled at once by the next position of the batch
+ *
+ * the rollouts are uniformly random over the legal moves, as the rollouts of basic_node without patterns
+ * the lanes are on the stack, since new does not align them before C++17
+ */
+template<class B>
+class basic_lockstep_rollouts {
+public:
+	enum { lanes = 16, rows = B::size_y };
+	static_assert(B::size_x <= 16, "a row of the board must fit in a lane");
+
+	basic_lockstep_rollouts(const std::array<uint16_t, lanes>& seeds) {
+		B initial;
+		for (int y = 0; y < rows; y++) {
+			uint16_t row = 0;
+			for (int x = 0; x < B::size_x; x++)
+				if (initial[x][y] != board::hollow) row |= 1u << x;
+			playable[y] = lanes16::fill(row);
+		}
+		random = lanes16::fill(0);
+		for (int l = 0; l < lanes; l++) random.set(l, seeds[l]);
+	}
+
+	/**
+	 * the values of the positions for who to move, 1 for a won rollout and 0 for a lost one
+	 */
+	void run(const B* states, const board::piece_type* who, size_t n, float* values) {
+		std::array<size_t, lanes> job;
+		size_t next = 0;
+		active = first = lanes16::fill(0);
+		for (int l = 0; l < lanes && next < n; l++) job[l] = next++, load(l, states[job[l]], who[job[l]]);
+		while (active.any()) {
+			lanes16 lost = step();
+			for (int l = 0; l < lanes; l++) {
+				if (lost.get(l) == 0) continue;
+				values[job[l]] = first.get(l) ? 0 : 1;
+				active.set(l, 0);
+			}
+			for (int y = 0; y < rows; y++) std::swap(own[y], opp[y]);
+			first = first ^ lanes16::fill(0xffff);
+			for (int l = 0; l < lanes && next < n; l++) {
+				if (lost.get(l) != 0) job[l] = next++, load(l, states[job[l]], who[job[l]]);
+			}
+		}
+	}
+
+	/**
+	 * the xorshift states, to continue the random sequences by the next rollouts
+	 */
+	std::array<uint16_t, lanes> seeds() const {
+		std::array<uint16_t, lanes> seeds;
+		for (int l = 0; l < lanes; l++) seeds[l] = random.get(l);
+		return seeds;
+	}
+
+private:
+	/**
+	 * put the position into the lane, with who to move
+	 */
+	void load(int lane, const B& state, board::piece_type who) {
+		for (int y = 0; y < rows; y++) {
+			uint16_t mine = 0, theirs = 0;
+			for (int x = 0; x < B::size_x; x++) {
+				if (state[x][y] == who) mine |= 1u << x;
+				else if (state[x][y] == 3u - who) theirs |= 1u << x;
+			}
+			own[y].set(lane, mine);
+			opp[y].set(lane, theirs);
+		}
+		first.set(lane, 0xffff);
+		active.set(lane, 0xffff);
+	}
+
+	/**
+	 * play a random legal move in every active lane, return the mask of the lanes without legal moves
+	 * a lane draws random candidates until one is legal, so the lanes wait for the one drawing the most
+	 */
+	lanes16 step() {
+		lanes16 empty[rows], candidate[rows], move[rows], p[rows], count[rows];
+		for (int y = 0; y < rows; y++) {
+			empty[y] = without(playable[y], own[y] | opp[y]);
+			candidate[y] = empty[y] & active;
+			move[y] = lanes16::fill(0);
+		}
+		lanes16 zero = lanes16::fill(0), pending = active, lost = zero;
+		while (true) {
+			lanes16 total = zero;
+			for (int y = 0; y < rows; y++) total = total + (count[y] = popcount(candidate[y]));
+			lanes16 exhausted = pending & eq(total, zero);
+			lost = lost | exhausted;
+			pending = without(pending, exhausted);
+			if (!pending.any()) break;
+			pick(candidate, count, total, p);
+			lanes16 ok = legal(p, empty) & pending;
+			pending = without(pending, ok);
+			for (int y = 0; y < rows; y++) {
+				move[y] = move[y] | (p[y] & ok);
+				candidate[y] = without(candidate[y], p[y]) & pending;
+			}
+		}
+		for (int y = 0; y < rows; y++) own[y] = own[y] | move[y];
+		return lost;
+	}
+
+	/**
+	 * pick a uniformly random candidate of each lane as a one-hot board, empty for lanes without candidates
+	 */
+	void pick(const lanes16* candidate, const lanes16* count, const lanes16& total, lanes16* p) {
+		random = random ^ shl<7>(random); // xorshift16
+		random = random ^ shr<9>(random);
+		random = random ^ shl<8>(random);
+		lanes16 r = mulhi(random, total), before = lanes16::fill(0);
+		lanes16 bits = before, k = before, zero = before;
+		for (int y = 0; y < rows; y++) {
+			lanes16 after = before + count[y];
+			p[y] = without(gt(after, r), gt(before, r)); // the row of the r-th candidate
+			bits = select(p[y], candidate[y], bits);
+			k = select(p[y], r - before, k);
+			before = after;
+		}
+		for (lanes16 more; (more = without(lanes16::fill(0xffff), eq(k, zero))).any(); k = k + more)
+			bits = select(more, bits & (bits - lanes16::fill(1)), bits); // drop the lowest bit k times
+		bits = bits & (zero - bits);
+		for (int y = 0; y < rows; y++) p[y] = p[y] & bits;
+	}
+
+	/**
+	 * return the mask of the lanes where the one-hot p is legal for the player to move,
+	 * i.e., its block has a liberty, and every adjacent opponent block still has a liberty
+	 */
+	lanes16 legal(const lanes16* p, const lanes16* empty) {
+		lanes16 zero = lanes16::fill(0), block[rows], within[rows], open[rows];
+		for (int y = 0; y < rows; y++) {
+			block[y] = p[y];
+			within[y] = own[y] | p[y];
+			open[y] = without(empty[y], p[y]);
+		}
+		flood(block, within);
+		lanes16 breath = without(lanes16::fill(0xffff), eq(liberty(block, open), zero));
+		lanes16 take = zero;
+		for (int d = 0; d < 4; d++) {
+			lanes16 seed = zero;
+			for (int y = 0; y < rows; y++) {
+				lanes16 from = d == 0 ? shl<1>(p[y]) : d == 1 ? shr<1>(p[y])
+				             : d == 2 ? (y > 0 ? p[y - 1] : zero) : (y + 1 < rows ? p[y + 1] : zero);
+				block[y] = from & opp[y];
+				seed = seed | block[y];
+			}
+			if (!seed.any()) continue;
+			flood(block, opp);
+			take = take | without(eq(liberty(block, open), zero), eq(seed, zero));
+		}
+		return without(breath, take);
+	}
+
+	/**
+	 * grow the blocks to the connected stones within
+	 */
+	static void flood(lanes16* block, const lanes16* within) {
+		lanes16 zero = lanes16::fill(0);
+		for (bool growing = true; growing; ) {
+			lanes16 grown = zero;
+			for (int y = 0; y < rows; y++) {
+				lanes16 next = block[y] | shl<1>(block[y]) | shr<1>(block[y]);
+				if (y > 0) next = next | block[y - 1];
+				if (y + 1 < rows) next = next | block[y + 1];
+				next = next & within[y];
+				grown = grown | (next ^ block[y]);
+				block[y] = next;
+			}
+			growing = grown.any();
+		}
+	}
+
+	/**
+	 * the union of the liberties of the blocks over all rows, nonzero in the lanes with a liberty
+	 */
+	static lanes16 liberty(const lanes16* block, const lanes16* open) {
+		lanes16 any = lanes16::fill(0);
+		for (int y = 0; y < rows; y++) {
+			lanes16 next = shl<1>(block[y]) | shr<1>(block[y]);
+			if (y > 0) next = next | block[y - 1];
+			if (y + 1 < rows) next = next | block[y + 1];
+			any = any | (next & open[y]);
+		}
+		return any;
+	}
+
+private:
+	lanes16 playable[rows];     // the positions which are not hollow
+	lanes16 own[rows], opp[rows]; // the stones of the player to move and of the opponent
+	lanes16 first;              // the lanes where the player to move is who of the position
+	lanes16 active;             // the lanes in a playout
+	lanes16 random;             // the xorshift states
+};
+
+/**
+ * the lockstep rollouts as an evaluator
+ */
+template<class B>
+class basic_lockstep_evaluator : public basic_evaluator<B> {
+public:
+	basic_lockstep_evaluator(unsigned seed = 0) {
+		std::default_random_engine seeder(seed);
+		for (uint16_t& s : seeds) s = 1 + seeder() % 0xffff; // xorshift needs nonzero
+	}
+
+	virtual void evaluate(const B* states, const board::piece_type* who, size_t n, float* values) {
+		basic_lockstep_rollouts<B> rollouts(seeds);
+		rollouts.run(states, who, n, values);
+		seeds = rollouts.seeds();
+	}
+
+private:
+	std::array<uint16_t, basic_lockstep_rollouts<B>::lanes> seeds;
+};
+
+typedef basic_lockstep_rollouts<board> lockstep_rollouts;
+typedef basic_lockstep_evaluator<board> lockstep_evaluator;
@@ -7,28 +7,29 @@
 #include <algorithm>
 #include "board.h"
 #include "action.h"
+#include "pattern.h"
+#include "evaluator.h"
 #include <fstream>
 #include <cmath>
 #include <unistd.h>
-#include <signal.h>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-std::default_random_engine engine;
-
-bool time_up = false;
-
-void mcts_timeout(int sig) {
-    time_up = true;
-}
-
-int space[] = {0, 1, 2, 3, 4, 5, 6, 7, 8,
-9, 10, 11, 12, 13, 14, 15, 16, 17,
-18, 19, 20, 21, 22, 23, 24, 25, 26,
-27, 28, 29, 30, 31, 32, 33, 34, 35,
-36, 37, 38, 39, 40, 41, 42, 43, 44,
-45, 46, 47, 48, 49, 50, 51, 52, 53,
-54, 55, 56, 57, 58, 59, 60, 61, 62,
-63, 64, 65, 66, 67, 68, 69, 70, 71,
-72, 73, 74, 75, 76, 77, 78, 79, 80};
+/**
+ * the random engine of the rollouts, one per thread so that searches can run in parallel
+ */
+thread_local std::default_random_engine engine;
 
 struct placement{
     /**
@@ -40,6 +41,69 @@ struct placement{
     placement(int p, board::piece_type w) : pos(p), who(w) {}
 };
 
+/**
+ * last-good-reply tables with forgetting, for each player: the reply to the last move,
+ * and with depth 2, the reply to the last two moves, which is tried first
+ * a reply is stored when the replying player wins the simulation, and cleared when it loses
+ */
+struct reply_table {
+    reply_table(int cells = 0, int depth = 1)
+        : cells(cells), depth(depth), single(2 * cells, -1), pair(depth >= 2 ? 2 * cells * cells : 0, -1) {}
+
+    /**
+     * return the stored reply of who to the last two moves (before is -1 if none), or -1 if there is none
+     */
+    int reply(unsigned who, int before, int last) const {
+        if (last == -1)     return -1;
+        if (depth >= 2 && before != -1) {
+            int move = pair[((who - 1) * cells + before) * cells + last];
+            if (move != -1)     return move;
+        }
+        return single[(who - 1) * cells + last];
+    }
+
+    /**
+     * learn from the moves of a simulation, the path in the tree followed by the playout
+     */
+    void learn(const std::vector<placement>& path, const std::vector<placement>& playout, board::piece_type winner) {
+        int before = -1, last = -1;
+        for (const std::vector<placement>* moves : { &path, &playout }) {
+            for (const placement& move : *moves) {
+                if (last != -1) {
+                    remember(single[(move.who - 1) * cells + last], move.pos, move.who == winner);
+                    if (depth >= 2 && before != -1)
+                        remember(pair[((move.who - 1) * cells + before) * cells + last], move.pos, move.who == winner);
+                }
+                before = last;
+                last = move.pos;
+            }
+        }
+    }
+
+private:
+    static void remember(int16_t& entry, int move, bool won) {
+        if (won)                    entry = move;
+        else if (entry == move)     entry = -1;
+    }
+
+private:
+    int cells;
+    int depth;
+    std::vector<int16_t> single;    // [who][last]
+    std::vector<int16_t> pair;      // [who][before][last]
+};
+
+/**
+ * the rollout policy of a search
+ */
+struct playout{
+    const pattern_table* patterns = NULL;   // heavy playouts if not NULL
+    bool race = false;      // stop once the move-count race is decided
+    int race_start = 20;    // check the race only with this many empty positions or less
+    int reply_depth = 0;    // play the last good reply to the last 1 or 2 moves if legal, disabled if 0
+    reply_table* replies = NULL;    // the tables learned by the search, see basic_mcts
+};
+
 struct sim_result{
     bool shyoubu;
     std::vector<placement> katei;
@@ -49,9 +113,205 @@ struct sim_result{
     }
 };
 
-class node{
+/**
+ * the tree file is a flat array of nodes in breadth-first order
+ *
+ *   header | record[count]
+ *
+ * the children of a node are consecutive records starting at first, in the order of their index,
+ * and the statistics of a child (Q, RAVE) are stored in its own record instead of its parent
+ */
+struct tree_file {
+    struct header {
+        char magic[8];
+        uint32_t version;
+        uint32_t cells;     // size of the board, to reject trees of another geometry
+        uint64_t key;       // hash of the root position
+        uint32_t who;       // player to move at the root
+        uint32_t count;     // number of records
+    };
+    struct record {
+        uint32_t first;     // index of the first child, 0 if not expanded
+        uint32_t N;
+        uint32_t N_RAVE;
+        float Q, Q_RAVE;
+        int16_t move;       // move from the parent, -1 for the root
+        uint8_t children;
+        uint8_t explored;
+        int8_t proof;
+        uint8_t terminated;
+    };
+
+    static constexpr uint32_t version = 1;
+};
+
+/**
+ * return the index of the child with the highest blended UCB+RAVE value
+ *   value = a * Q + b * Q_RAVE + offset + blocked + sqrt(k / N)
+ * where the perspective flip is folded into a, b and offset, and k = c^2 * log(N of parent)
+ * without RAVE the Q_RAVE term is left out, and with PUCT the exploration term is k * P / (1 + N)
+ * the arrays are padded to a multiple of 4, with blocked = -inf for proven and padding children
+ */
+template<bool RAVE = true, bool PUCT = false>
+int select_ucb(const double* N, const double* Q, const double* Q_RAVE, const double* blocked, const double* P, int n,
+               double a, double b, double offset, double k) {
+    int i = 0;
+    double best_value = -std::numeric_limits<double>::infinity();
+    int best = -1;
+#if defined(__AVX2__)
+    __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b), voff = _mm256_set1_pd(offset), vk = _mm256_set1_pd(k);
+    __m256d vbest = _mm256_set1_pd(best_value), vbest_i = _mm256_set1_pd(-1);
+    __m256d vi = _mm256_set_pd(3, 2, 1, 0), vstep = _mm256_set1_pd(4), vone = _mm256_set1_pd(1);
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_add_pd(_mm256_mul_pd(va, _mm256_loadu_pd(Q + i)), RAVE ? _mm256_add_pd(_mm256_mul_pd(vb, _mm256_loadu_pd(Q_RAVE + i)), voff) : voff);
+        __m256d u = PUCT ? _mm256_div_pd(_mm256_mul_pd(vk, _mm256_loadu_pd(P + i)), _mm256_add_pd(_mm256_loadu_pd(N + i), vone))
+                         : _mm256_sqrt_pd(_mm256_div_pd(vk, _mm256_loadu_pd(N + i)));
+        v = _mm256_add_pd(_mm256_add_pd(v, _mm256_loadu_pd(blocked + i)), u);
+        __m256d ge = _mm256_cmp_pd(v, vbest, _CMP_GE_OQ);
+        vbest = _mm256_blendv_pd(vbest, v, ge);
+        vbest_i = _mm256_blendv_pd(vbest_i, vi, ge);
+        vi = _mm256_add_pd(vi, vstep);
+    }
+    double lane[4], lane_i[4];
+    _mm256_storeu_pd(lane, vbest);
+    _mm256_storeu_pd(lane_i, vbest_i);
+    for (int l = 0; l < 4; l++) {
+        if (lane_i[l] >= 0 && (lane[l] > best_value || (lane[l] == best_value && lane_i[l] > best))) {
+            best_value = lane[l];
+            best = lane_i[l];
+        }
+    }
+#elif defined(__SSE2__)
+    __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b), voff = _mm_set1_pd(offset), vk = _mm_set1_pd(k);
+    __m128d vbest = _mm_set1_pd(best_value), vbest_i = _mm_set1_pd(-1);
+    __m128d vi = _mm_set_pd(1, 0), vstep = _mm_set1_pd(2), vone = _mm_set1_pd(1);
+    for (; i + 2 <= n; i += 2) {
+        __m128d v = _mm_add_pd(_mm_mul_pd(va, _mm_loadu_pd(Q + i)), RAVE ? _mm_add_pd(_mm_mul_pd(vb, _mm_loadu_pd(Q_RAVE + i)), voff) : voff);
+        __m128d u = PUCT ? _mm_div_pd(_mm_mul_pd(vk, _mm_loadu_pd(P + i)), _mm_add_pd(_mm_loadu_pd(N + i), vone))
+                         : _mm_sqrt_pd(_mm_div_pd(vk, _mm_loadu_pd(N + i)));
+        v = _mm_add_pd(_mm_add_pd(v, _mm_loadu_pd(blocked + i)), u);
+        __m128d ge = _mm_cmpge_pd(v, vbest);
+        vbest = _mm_or_pd(_mm_and_pd(ge, v), _mm_andnot_pd(ge, vbest));
+        vbest_i = _mm_or_pd(_mm_and_pd(ge, vi), _mm_andnot_pd(ge, vbest_i));
+        vi = _mm_add_pd(vi, vstep);
+    }
+    double lane[2], lane_i[2];
+    _mm_storeu_pd(lane, vbest);
+    _mm_storeu_pd(lane_i, vbest_i);
+    for (int l = 0; l < 2; l++) {
+        if (lane_i[l] >= 0 && (lane[l] > best_value || (lane[l] == best_value && lane_i[l] > best))) {
+            best_value = lane[l];
+            best = lane_i[l];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        double value = a * Q[i] + (RAVE ? b * Q_RAVE[i] : 0) + offset + blocked[i] + (PUCT ? k * P[i] / (N[i] + 1) : std::sqrt(k / N[i]));
+        if (value >= best_value) {
+            best_value = value;
+            best = i;
+        }
+    }
+    return best_value == -std::numeric_limits<double>::infinity() ? -1 : best;
+}
+
+/**
+ * the tree policies, which pick the child to descend from a node, see basic_node::select()
+ * the root player and the constants are fixed for a search, so only the perspective of the node is tested
+ * a policy which explores all children first only picks from fully explored nodes
+ */
+struct uct_policy {
+    board::piece_type root;
+    double c;
+
+    template<class N>
+    int pick(N& n) const {
+        double sign = (root == n.who) ? 1 : -1;
+        return select_ucb<false>(n.child_N(), n.child_Q(), n.child_Q_RAVE(), n.child_blocked(), n.child_P(), n.stride,
+                                 sign, 0, (root == n.who) ? 0 : 1, c * c * std::log(n.N));
+    }
+    bool explores_all() const { return true; }
+};
+
+/**
+ * UCT blended with the RAVE values by a fixed weight, which needs the statistics of rave_backup
+ */
+struct rave_policy {
+    board::piece_type root;
+    double c;
+    double RAVE;
+
+    template<class N>
+    int pick(N& n) const {
+        double sign = (root == n.who) ? 1 : -1;
+        return select_ucb<true>(n.child_N(), n.child_Q(), n.child_Q_RAVE(), n.child_blocked(), n.child_P(), n.stride,
+                                sign * (1 - RAVE), sign * RAVE, (root == n.who) ? 0 : 1, c * c * std::log(n.N));
+    }
+    bool explores_all() const { return true; }
+};
+
+/**
+ * PUCT by the priors of the children, i.e., value = Q + c * P * sqrt(N of parent) / (1 + N)
+ * with a first-play reduction r >= 0, the unexplored children compete by their priors at the first-play value,
+ * i.e., the value of the node for its player minus r, instead of being explored first
+ */
+struct puct_policy {
+    board::piece_type root;
+    double c;
+    double reduction;   // explore all children first if < 0
+
+    template<class N>
+    int pick(N& n) const {
+        double sign = (root == n.who) ? 1 : -1;
+        if (n.explored_child < n.num_of_child)
+            std::fill(n.child_Q() + n.explored_child, n.child_Q() + n.num_of_child, first_play(n, sign));
+        return select_ucb<false, true>(n.child_N(), n.child_Q(), n.child_Q_RAVE(), n.child_blocked(), n.child_P(), n.stride,
+                                       sign, 0, (root == n.who) ? 0 : 1, c * std::sqrt(n.N));
+    }
+    bool explores_all() const { return reduction < 0; }
+
+    /**
+     * the first-play value of the root player, from the mean value of the explored children (or of the node if none)
+     */
+    template<class N>
+    double first_play(N& n, double sign) const {
+        double sum = 0, visits = 0;
+        for (int i = 0; i < n.explored_child; i++) {
+            sum += n.child_N()[i] * n.child_Q()[i];
+            visits += n.child_N()[i];
+        }
+        return (visits ? sum / visits : n.value()) - sign * reduction;
+    }
+};
+
+/**
+ * the weights of the cheap features of a move, whose softmax is the prior of the move, see basic_node::assign_priors()
+ */
+struct prior_features {
+    double safe = -3;       // the move fills a point the opponent cannot play, i.e., an own safe point
+    double reduce = 0.4;    // per legal move of the opponent taken away by the move, including the point itself
+    double border = 0.2;    // per neighbor of the move at the edge or in the hollow
+};
+
+/**
+ * the backup rules, after the mean outcome of the simulations is updated along the path
+ */
+struct mean_backup {};  // nothing more
+struct rave_backup {};  // the all-moves-as-first values of the moves in the path and the playout
+
+/**
+ * the stopping conditions, besides the stop flag and a proven root
+ */
+struct count_limit {};  // until the root is visited the given times
+struct time_limit {};   // until the deadline
+
+/**
+ * search tree node on a board of any geometry, see basic_board
+ */
+template<class B>
+class basic_node{
 public:
-    node(board new_board, board::piece_type player_type){
+    basic_node(const B& new_board, board::piece_type player_type){
         // init
         who = player_type;
         if (who == board::black)    child_type = board::white;
@@ -59,40 +319,31 @@ public:
         current = new_board;
     }
 
-    ~node() {
-        for (node* child : children) {
+    ~basic_node() {
+        for (basic_node* child : children) {
             delete child;
         }
     }
 
     /**
-     * return the child node with highest UCB, or itself if the node has unexplored child
+     * return the child node picked by the tree policy, or itself to expand the next unexplored child,
+     * which is at once if the policy explores all children first, or once the policy picks any unexplored child
+     * (the unexplored children are in descending order of their priors, so the next one is as good as any)
+     * the statistics of children are kept here as arrays, see select_ucb()
      */
-    node* select(board::piece_type root_type, double RAVE) {
-        if (num_of_child != explored_child || num_of_child == 0)     return this;
-        double best_value = 0;
-        double c = 0.7;
-        node* best=NULL;
-        for (node* child : children) {
-            double value;
-            if (root_type == who)   
-                value = (1 - RAVE) * child->Q + RAVE * child->Q_RAVE + std::sqrt(std::log(N) / child->N) * c;
-            else
-                value = (1 - RAVE) * (1 - child->Q) + RAVE * (1 - child->Q_RAVE) + std::sqrt(std::log(N) / child->N) * c;
-            if (value >= best_value) {
-                best_value = value;
-                best = child;
-            }
-        }
-        return best;
+    template<class Tree>
+    basic_node* select(const Tree& tree) {
+        if (num_of_child == 0 || (num_of_child != explored_child && tree.explores_all()))   return this;
+        int best = tree.pick(*this);
+        return best != -1 && best < explored_child ? children[best] : this;
     }
 
     /**
      * return the node expanded to simulate
-     * if is leaf (num_of_child == 0), create all children first before return
+     * if is leaf (num_of_child == 0), create all children first before return, with the priors of the features if given
      * if the node is terminal, return itself
      */
-    node* expand() {
+    basic_node* expand(const prior_features* features = NULL) {
         if (num_of_child != 0 && explored_child == num_of_child) {
             std::cout<<"WTF?";
             exit(1);
@@ -102,22 +353,29 @@ public:
         }
         else if (num_of_child == 0) {
             // generate all children
-            for (int pos : space) {
-                board after = current;
-                action::place move = action::place(pos, who);
-                if (move.apply(after) == board::legal) {
-                    node* child = new node(after, child_type);
+            for (int pos : space()) {
+                B after = current;
+                if (after.place(typename B::point(pos), who) == board::legal) {
+                    basic_node* child = new basic_node(after, child_type);
                     child->parent = this;
                     child->parent_move = pos;
+                    child->index = children.size();
                     children.push_back(child);
                 }
             }
             num_of_child = children.size();
+            stride = (num_of_child + 3) & ~3;
+            stats.assign(stride * 6, 0);
+            std::fill(child_N() + num_of_child, child_N() + stride, 1);
+            std::fill(child_blocked() + num_of_child, child_blocked() + stride, -std::numeric_limits<double>::infinity());
 
             if (num_of_child == 0) {
                 terminated = true;
+                prove(-1);
                 return this;
             }
+            if (features != NULL)   assign_priors(*features);
+            else                    std::fill(child_P(), child_P() + num_of_child, 1.0 / num_of_child);
             return children[explored_child++];
         }
         else {
@@ -125,23 +383,71 @@ public:
         }
     }
 
+    /**
+     * set the priors of the new children as the softmax of their features, and sort them in descending order of the priors
+     * the features of a move are whether it fills a point illegal for the opponent, the legal moves of the opponent
+     * it takes away, and its neighbors at the edge or in the hollow, see prior_features
+     */
+    void assign_priors(const prior_features& features) {
+        std::array<bool, B::cells + 1> open{};
+        int moves[B::cells];
+        int before = current.legal_moves(child_type, moves);
+        for (int i = 0; i < before; i++)    open[moves[i]] = true;
+        std::vector<double> logit(num_of_child);
+        double most = -std::numeric_limits<double>::infinity(), sum = 0;
+        for (int i = 0; i < num_of_child; i++) {
+            int pos = children[i]->parent_move, borders = 0;
+            for (int q : B::table.adjacent[pos])    borders += (q == B::border);
+            logit[i] = (open[pos] ? 0 : features.safe) + features.border * borders
+                     + features.reduce * (before - children[i]->current.legal_moves(child_type));
+            most = std::max(most, logit[i]);
+        }
+        std::vector<int> order(num_of_child);
+        for (int i = 0; i < num_of_child; i++) {
+            order[i] = i;
+            sum += (logit[i] = std::exp(logit[i] - most));
+        }
+        std::stable_sort(order.begin(), order.end(), [&logit](int a, int b) { return logit[a] > logit[b]; });
+        std::vector<basic_node*> sorted(num_of_child);
+        for (int i = 0; i < num_of_child; i++) {
+            sorted[i] = children[order[i]];
+            sorted[i]->index = i;
+            child_P()[i] = logit[order[i]] / sum;
+        }
+        children.swap(sorted);
+    }
+
     /**
      * return true if win for root peice type
-     * both player play randomly
+     * both player play randomly, or by the pattern weights if given, unless a last good reply is legal
+     * the playout stops early once the rest of the game is decided by the move-count race
      */ 
-    sim_result simulate(board::piece_type root_player) {
-        board simulate = current;
+    sim_result simulate(board::piece_type root_player, const playout& policy) {
+        if (policy.patterns != NULL)    return simulate_pattern(root_player, policy);
+        B simulate = current;
         board::piece_type current_player = who;
         bool checkmate = true;
+        int empties = policy.race ? count_empty(current) : 0;
+        int before = (parent != NULL) ? parent->parent_move : -1, last = parent_move;
         sim_result kekka;
         for (;;) {
-            std::shuffle(&space[0], &space[81], engine);
-            for (int pos : space) {
-                action::place move = action::place(pos, current_player);
-                if (move.apply(simulate) == board::legal) {
-                    checkmate = false;
-                    kekka.katei.emplace_back(placement(pos, current_player));
-                    break;
+            int decided;
+            if (policy.race && empties <= policy.race_start && (decided = race(simulate, current_player)) != 0) {
+                kekka.shyoubu = ((decided > 0) == (current_player == root_player));
+                return kekka;
+            }
+            int reply = (policy.replies != NULL) ? policy.replies->reply(current_player, before, last) : -1;
+            if (reply != -1 && simulate.place(typename B::point(reply), current_player) == board::legal) {
+                checkmate = false;
+                kekka.katei.emplace_back(placement(reply, current_player));
+            } else {
+                std::shuffle(space().begin(), space().end(), engine);
+                for (int pos : space()) {
+                    if (simulate.place(typename B::point(pos), current_player) == board::legal) {
+                        checkmate = false;
+                        kekka.katei.emplace_back(placement(pos, current_player));
+                        break;
+                    }
                 }
             }
             if (checkmate) {
@@ -150,31 +456,190 @@ public:
             }
             else {
                 checkmate = true;
+                before = last;
+                last = kekka.katei.back().pos;
+                empties--;
                 current_player = (current_player == board::black ? board::white : board::black);
             }
         }
     }
 
+    sim_result simulate_pattern(board::piece_type root_player, const playout& policy) {
+        basic_pattern_board<B> simulate(current, *policy.patterns);
+        board::piece_type current_player = who;
+        int empties = policy.race ? count_empty(current) : 0;
+        int before = (parent != NULL) ? parent->parent_move : -1, last = parent_move;
+        sim_result kekka;
+        for (int pos; ; ) {
+            int decided;
+            if (policy.race && empties <= policy.race_start && (decided = race(simulate.current(), current_player)) != 0) {
+                kekka.shyoubu = ((decided > 0) == (current_player == root_player));
+                return kekka;
+            }
+            pos = (policy.replies != NULL) ? policy.replies->reply(current_player, before, last) : -1;
+            if ((pos == -1 || !simulate.play_at(pos, current_player)) && (pos = simulate.play(current_player, engine)) == -1)  break;
+            kekka.katei.emplace_back(placement(pos, current_player));
+            before = last;
+            last = pos;
+            empties--;
+            current_player = (current_player == board::black ? board::white : board::black);
+        }
+        kekka.shyoubu = (current_player != root_player);
+        return kekka;
+    }
+
+    /**
+     * return 1 if mover surely wins the rest of the game, -1 if mover surely loses, or 0 if undecided
+     * a player can play at most its legal moves (illegal positions never become legal in NoGo),
+     * and at least its safe moves, so the race is decided once the bounds do not overlap
+     */
+    static int race(const B& b, board::piece_type mover) {
+        board::piece_type opp = (mover == board::black ? board::white : board::black);
+        int safe = b.safe_moves(mover);
+        if (safe > 0 && safe > b.legal_moves(opp))      return 1;
+        int opp_safe = b.safe_moves(opp);
+        if (opp_safe > 0 && opp_safe >= b.legal_moves(mover))  return -1;
+        return 0;
+    }
+
+    static int count_empty(const B& b) {
+        int empties = 0;
+        for (int pos : space())     empties += (b(pos) == board::empty);
+        return empties;
+    }
+
+    /**
+     * all positions of the board, in the order shuffled by the last random playout of this thread
+     */
+    static std::array<int, B::cells>& space() {
+        static thread_local std::array<int, B::cells> positions = []() {
+            std::array<int, B::cells> positions;
+            for (int i = 0; i < B::cells; i++)  positions[i] = i;
+            return positions;
+        }();
+        return positions;
+    }
+
     /**
      * return the parent node to update
      */
-    node* update(bool victory) {
+    basic_node* update(double victory) {
         N++;
-        Q += (victory - Q) / N;
+        if (parent != NULL) {
+            double& Q = parent->child_Q()[index];
+            parent->child_N()[index] = N;
+            Q += (victory - Q) / N;
+        }
         return parent;
     }
 
-    void RAVE_update(bool victory) {
+    /**
+     * replace a value already counted by update(), e.g., a virtual loss by the evaluated value
+     */
+    basic_node* revise(double from, double to) {
+        if (parent != NULL)     parent->child_Q()[index] += (to - from) / N;
+        return parent;
+    }
+
+    /**
+     * update the RAVE value of the i-th child
+     */
+    void RAVE_update(int i, double victory) {
+        double& N_RAVE = child_N_RAVE()[i];
+        double& Q_RAVE = child_Q_RAVE()[i];
         N_RAVE++;
         Q_RAVE += (victory - Q_RAVE) / N_RAVE;
     }
 
-    action::place best_action() {
+    /**
+     * the win rate of the root player after the move to this node, see update()
+     */
+    double value() const {
+        return parent != NULL ? parent->stats[parent->stride + index] : 0.5;
+    }
+
+    /**
+     * the most visited line from this node, starting with the move to this node
+     */
+    std::vector<int> principal_variation() const {
+        std::vector<int> line;
+        for (const basic_node* n = this; n != NULL && n->N > 0; ) {
+            line.push_back(n->parent_move);
+            const basic_node* next = NULL;
+            for (const basic_node* child : n->children) {
+                if (child->N > 0 && (next == NULL || child->N > next->N))   next = child;
+            }
+            n = next;
+        }
+        return line;
+    }
+
+    /**
+     * mark the node as proven, and block it from the selection of its parent
+     */
+    void prove(int result) {
+        proof = result;
+        if (parent != NULL)     parent->child_blocked()[index] = -std::numeric_limits<double>::infinity();
+    }
+
+    /**
+     * return the bytes allocated by the expansion of this node, not counting the subtrees of children
+     */
+    size_t footprint() const {
+        return children.size() * sizeof(basic_node) + children.capacity() * sizeof(basic_node*) + stats.capacity() * sizeof(double);
+    }
+
+    size_t subtree_footprint() const {
+        size_t bytes = footprint();
+        for (basic_node* child : children)   bytes += child->subtree_footprint();
+        return bytes;
+    }
+
+    /**
+     * delete the subtree below the node, so that it becomes an unexpanded leaf again
+     * the statistics of the node itself are kept, return the bytes released
+     */
+    size_t collapse() {
+        size_t released = subtree_footprint();
+        for (basic_node* child : children) {
+            delete child;
+        }
+        std::vector<basic_node*>().swap(children);
+        std::vector<double>().swap(stats);
+        num_of_child = explored_child = stride = 0;
+        return released;
+    }
+
+    /**
+     * mark the node as proven from its children, return true if it is newly proven
+     * a child lost for its player is a win, and all children won for their player is a loss
+     */
+    bool solve() {
+        if (proof != 0 || num_of_child == 0)  return false;
+        bool all_won = true;
+        for (basic_node* child : children) {
+            if (child->proof == -1) {
+                prove(1);
+                return true;
+            }
+            all_won &= (child->proof == 1);
+        }
+        if (all_won)    prove(-1);
+        return proof != 0;
+    }
+
+    /**
+     * return the most visited move, preferring proven wins over unproven moves over proven losses
+     */
+    action::place best_action() const {
         int most_visit_count = 0;
+        int best_rank = -2;
         int best_move = -1;
-        for (node* child : children) {
+        for (basic_node* child : children) {
             int visit_count = child->N;
-            if (visit_count >= most_visit_count) {
+            int rank = -child->proof;
+            if (rank > best_rank || (rank == best_rank && visit_count >= most_visit_count)) {
+                best_rank = rank;
                 most_visit_count = visit_count;
                 best_move = child->parent_move;
             } 
@@ -183,38 +648,132 @@ public:
     }
 
 public:
-    board current;
+    B current;
     int num_of_child = 0, explored_child = 0;
     board::piece_type who;  //type to play next
     board::piece_type child_type;
-    node* parent = NULL;
-    std::vector<node*> children;
+    basic_node* parent = NULL;
+    std::vector<basic_node*> children;
     bool terminated = false;
-    int N = 0, N_RAVE = 0, parent_move = -1;
-    double Q = 0, Q_RAVE = 0;
+    int proof = 0;  // 1 if proven win for who, -1 if proven loss, 0 if unknown
+    int N = 0, parent_move = -1;
+    int index = 0;  // index in the children of parent
+
+    // statistics of children, in 6 arrays of stride (num_of_child padded to a multiple of 4)
+    int stride = 0;
+    std::vector<double> stats;
+    double* child_N() { return &stats[0]; }
+    double* child_Q() { return &stats[stride]; }
+    double* child_N_RAVE() { return &stats[stride * 2]; }
+    double* child_Q_RAVE() { return &stats[stride * 3]; }
+    double* child_blocked() { return &stats[stride * 4]; }  // -inf if proven
+    double* child_P() { return &stats[stride * 5]; }        // the prior, 0 for padding
 };
 
 
-class mcts{
+template<class B>
+class basic_mcts{
 public:
-    mcts(const board& root_board, board::piece_type player_type, int c, int t, double r = 0) : 
-        root(root_board, player_type), cycles(c), think_time(t), RAVE(r) {
+    enum tree_policy { uct, uct_rave, puct };   // see uct_policy, rave_policy and puct_policy
+
+    basic_mcts(const B& root_board, board::piece_type player_type, int c, int t, double r = 0, const playout& p = playout()) : 
+        root(root_board, player_type), cycles(c), think_time(t), RAVE(r), policy(p), tree(r != 0 ? uct_rave : uct) {
             path.clear();
+            if (policy.reply_depth > 0) {
+                replies = reply_table(B::cells, policy.reply_depth);
+                policy.replies = &replies;
+            }
         }
+    basic_mcts(const basic_mcts&) = delete;     // the playout policy refers to the reply tables of this search
+
+    /**
+     * select by the given tree policy instead of UCT (or UCT+RAVE if the RAVE weight is set),
+     * with the exploration constant c, or the default of the policy if 0
+     */
+    void use_tree_policy(tree_policy kind, double c = 0) {
+        tree = kind;
+        exploration = c;
+    }
+
+    /**
+     * limit the memory of the tree to the given bytes (0 for unlimited)
+     * once reached, release the subtrees of the least visited nodes if prune is set,
+     * or stop expanding and keep simulating from the existing leaves otherwise (also if pruning cannot meet the limit)
+     */
+    void limit_memory(size_t bytes, bool prune) {
+        mem_limit = bytes;
+        mem_prune = prune;
+        prune_at = bytes;
+    }
+
+    /**
+     * score the leaves by the evaluator in batches of the given size, instead of one rollout per leaf
+     * the leaves waiting for evaluation hold a virtual loss, so that a batch spreads over the tree
+     */
+    void use_evaluator(basic_evaluator<B>* e, size_t size) {
+        eval = e;
+        batch = std::max<size_t>(size, 1);
+    }
+
+    /**
+     * search the root by sequential halving over a shortlist of the given number of candidates (0 to disable),
+     * sampled by Gumbel noise on the values of the first visits, while the children below the root are still picked by the tree policy
+     * each of the log2(shortlist) phases spends an equal share of the budget, split evenly over the survivors,
+     * and then keeps the better half by the score g + (50 + max N) * Q, see halve()
+     */
+    void use_sequential_halving(size_t candidates) {
+        shortlist = candidates;
+    }
 
-    node* select() {
-        node* selecting = &root;
-        node* next;
-        while ((next = selecting->select(root.who, RAVE)) != selecting) {
+    /**
+     * give the new children the priors of their features instead of uniform priors, and expand them in that order
+     * with PUCT and a first-play reduction >= 0, pick the unexplored children by their priors instead of exploring all first,
+     * see puct_policy
+     */
+    void use_priors(const prior_features& f, double reduction = 0.25) {
+        features = f;
+        priors = true;
+        first_play_reduction = reduction;
+    }
+
+    /**
+     * stop the search as soon as the flag is set, e.g., by another thread
+     */
+    void stop_on(const std::atomic<bool>* flag) {
+        stop = flag;
+    }
+
+    /**
+     * call the hook with the tree every interval milliseconds during the search
+     */
+    void on_progress(int interval, std::function<void(const basic_mcts&)> hook) {
+        progress_interval = std::chrono::milliseconds(std::max(interval, 1));
+        progress = hook;
+    }
+
+    template<class Tree>
+    basic_node<B>* select(const Tree& tree) {
+        if (mem_limit != 0 && mem_prune && tree_bytes >= prune_at && pending == 0)   prune();
+        basic_node<B>* selecting = &root;
+        basic_node<B>* next;
+        if (shortlist > 1 && root.num_of_child > 1 && root.explored_child == root.num_of_child && root.proof == 0
+                && (next = candidate()) != &root) {
+            selecting = next;
+            path.emplace_back(placement(selecting->parent_move, root.who));
+        }
+        while ((next = selecting->select(tree)) != selecting) {
             selecting = next;
             path.emplace_back(placement(selecting->parent_move, selecting->parent->who));
         }
         return selecting;
     }
 
-    node* expand(node* to_expand) {
+    basic_node<B>* expand(basic_node<B>* to_expand) {
+        bool leaf = (to_expand->num_of_child == 0);
+        if (leaf && mem_limit != 0 && tree_bytes >= mem_limit)   return to_expand;
         // std::cout<<"expanding...\n";
-        node* to_sim = to_expand->expand();
+        basic_node<B>* to_sim = to_expand->expand(priors ? &features : NULL);
+        if (leaf)   tree_bytes += to_expand->footprint();
         // std::cout<<"emplacing...\n";
         if (to_sim != to_expand) {
             path.emplace_back(placement(to_sim->parent_move, to_sim->parent->who));
@@ -222,27 +781,31 @@ public:
         return to_sim;
     }
 
-    sim_result simulate(node* to_simulate) {
-        return to_simulate->simulate(root.who);
+    sim_result simulate(basic_node<B>* to_simulate) {
+        simulations++;
+        return to_simulate->simulate(root.who, policy);
     }
 
-    void update(node* leaf, bool win) {
+    void update(basic_node<B>* leaf, double win) {
+        for (basic_node<B>* proven = leaf->parent; proven != NULL && leaf->proof != 0 && proven->solve(); proven = proven->parent) {
+            continue;
+        }
         while((leaf = leaf->update(win)) != NULL) {
             continue;
         }
     }
 
-    void traverse(bool win, node* start) {
+    void traverse(double win, basic_node<B>* start) {
         while(start != NULL) {
-            for (node* child : start->children) {
+            for (basic_node<B>* child : start->children) {
                 for (placement move : path) {
                     if (child->parent_move == move.pos && child->parent->who == move.who) {
-                        child->RAVE_update(win);
+                        start->RAVE_update(child->index, win);
                     }
                 }
                 for (placement move : mogi.katei) {
                     if (child->parent_move == move.pos && child->parent->who == move.who) {
-                        child->RAVE_update(win);
+                        start->RAVE_update(child->index, win);
                     }
                 }
             }
@@ -250,61 +813,447 @@ public:
         }
     }
 
+    /**
+     * search by the configured policies, dispatched once to the search of the matching types
+     */
     action::place tree_search(bool debug = false) {
-        if (cycles != 0) {
-            if (RAVE != 0) {
-                for (int i = 0; i < cycles; i++) {
-                    path.clear();
-                    mogi.katei.clear();
-                    node* working = select();
-                    working = expand(working);
-                    mogi = simulate(working);
-                    update(working, mogi.shyoubu);
-                    traverse(mogi.shyoubu, working);
-                }
+        deadline = clock::now() + std::chrono::milliseconds(think_time);
+        survivors.clear();
+        next_progress = clock::now() + progress_interval;
+        switch (tree) {
+            case uct_rave:  return dispatch(rave_policy{ root.who, exploration ? exploration : 0.7, RAVE }, rave_backup());
+            case puct:      return dispatch(puct_policy{ root.who, exploration ? exploration : 1.5, priors ? first_play_reduction : -1 }, mean_backup());
+            default:        return dispatch(uct_policy{ root.who, exploration ? exploration : 0.7 }, mean_backup());
+        }
+    }
+
+    const basic_node<B>& root_node() const {
+        return root;
+    }
+
+    /**
+     * write the tree as a tree file, see tree_file
+     */
+    void save(const std::string& file) const {
+        std::vector<const basic_node<B>*> order(1, &root);
+        std::vector<tree_file::record> records;
+        for (size_t i = 0; i < order.size(); i++) {
+            const basic_node<B>* n = order[i];
+            tree_file::record r;
+            std::memset(&r, 0, sizeof(r));
+            r.first = n->children.size() ? order.size() : 0;
+            r.N = n->N;
+            r.move = n->parent_move;
+            r.children = n->num_of_child;
+            r.explored = n->explored_child;
+            r.proof = n->proof;
+            r.terminated = n->terminated;
+            if (n->parent != NULL) {
+                basic_node<B>& parent = *n->parent;
+                r.Q = parent.child_Q()[n->index];
+                r.N_RAVE = parent.child_N_RAVE()[n->index];
+                r.Q_RAVE = parent.child_Q_RAVE()[n->index];
             }
-            else {
-                for (int i = 0; i < cycles; i++) {
-                    node* working = select();
-                    working = expand(working);
-                    mogi = simulate(working);
-                    update(working, mogi.shyoubu);
-                }
+            order.insert(order.end(), n->children.begin(), n->children.end());
+            records.push_back(r);
+        }
+        tree_file::header head;
+        std::memset(&head, 0, sizeof(head));
+        std::memcpy(head.magic, "NOGOTREE", 8);
+        head.version = tree_file::version;
+        head.cells = B::cells;
+        head.key = root.current.hash();
+        head.who = root.who;
+        head.count = records.size();
+        std::ofstream out(file, std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(tree_file::record));
+        if (!out) throw std::runtime_error("cannot write tree: " + file);
+    }
+
+    /**
+     * warm start from a tree file of the same root position, replacing the current tree
+     * return false if the file does not exist or belongs to another position
+     */
+    bool load(const std::string& file) {
+        int fd = open(file.c_str(), O_RDONLY);
+        if (fd == -1) return false;
+        struct stat st;
+        void* base = MAP_FAILED;
+        size_t length = 0;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(tree_file::header)) {
+            length = st.st_size;
+            base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        const tree_file::header& head = *static_cast<const tree_file::header*>(base);
+        const tree_file::record* records = reinterpret_cast<const tree_file::record*>(static_cast<const char*>(base) + sizeof(head));
+        bool valid = std::memcmp(head.magic, "NOGOTREE", 8) == 0 && head.version == tree_file::version
+                && head.cells == unsigned(B::cells) && head.count > 0
+                && length >= sizeof(head) + head.count * sizeof(tree_file::record);
+        bool same = valid && head.key == root.current.hash() && head.who == unsigned(root.who);
+        if (same) {
+            basic_node<B> fresh(root.current, root.who);
+            size_t bytes = sizeof(basic_node<B>);
+            if (!restore(fresh, records, 0, head.count, bytes)) {
+                munmap(base, length);
+                throw std::invalid_argument("invalid tree: " + file);
             }
+            root.collapse();
+            root.N = fresh.N;
+            root.proof = fresh.proof;
+            root.terminated = fresh.terminated;
+            root.num_of_child = fresh.num_of_child;
+            root.explored_child = fresh.explored_child;
+            root.stride = fresh.stride;
+            root.children.swap(fresh.children);
+            root.stats.swap(fresh.stats);
+            for (basic_node<B>* child : root.children)   child->parent = &root;
+            tree_bytes = bytes;
         }
-        else {
-            time_up = false;
-            signal(SIGALRM, &mcts_timeout);
-            ualarm(think_time * 1000, 0);
-            if (RAVE != 0) {
-                while(1) {
-                    path.clear();
-                    node* working = select();
-                    working = expand(working);
-                    mogi = simulate(working);
-                    update(working, mogi.shyoubu);
-                    traverse(mogi.shyoubu, working);
-                    if (time_up)   break;
+        munmap(base, length);
+        if (!valid) throw std::invalid_argument("invalid tree: " + file);
+        return same;
+    }
+
+    /**
+     * the visits of the children of the root, as (move, visits)
+     */
+    std::vector<std::pair<int, int>> root_visits() const {
+        std::vector<std::pair<int, int>> visits;
+        for (const basic_node<B>* child : root.children)     visits.emplace_back(child->parent_move, child->N);
+        return visits;
+    }
+
+    /**
+     * the win rate of the player to move at the root, averaged over the visits of the children
+     */
+    double root_value() const {
+        if (root.proof != 0)    return root.proof > 0;
+        double sum = 0, visits = 0;
+        for (const basic_node<B>* child : root.children) {
+            sum += child->N * root.stats[root.stride + child->index];
+            visits += child->N;
+        }
+        return visits ? sum / visits : 0.5;
+    }
+
+    size_t simulation_count() const {
+        return simulations;
+    }
+
+    size_t memory_usage() const {
+        return tree_bytes;
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    template<class Tree, class Backup>
+    action::place dispatch(const Tree& tree, Backup backup) {
+        if (eval != NULL)   return cycles != 0 ? batch_search(tree, backup, count_limit()) : batch_search(tree, backup, time_limit());
+        return cycles != 0 ? search(tree, backup, count_limit()) : search(tree, backup, time_limit());
+    }
+
+    /**
+     * the tree search with a rollout per leaf, the root is simulated at least once to have a move
+     */
+    template<class Tree, class Backup, class Stop>
+    action::place search(const Tree& tree, Backup backup, Stop until) {
+        while (root.proof == 0 && (root.N == 0 || running(until))) {
+            path.clear();
+            basic_node<B>* working = expand(select(tree));
+            mogi = simulate(working);
+            update(working, mogi.shyoubu);
+            if (policy.replies != NULL)     replies.learn(path, mogi.katei, mogi.shyoubu ? root.who : root.child_type);
+            collect(backup, working, mogi.shyoubu);
+        }
+        if (progress)   progress(*this);
+        return decision();
+    }
+
+    /**
+     * the tree search with leaves evaluated in batches, see use_evaluator()
+     */
+    template<class Tree, class Backup, class Stop>
+    action::place batch_search(const Tree& tree, Backup backup, Stop until) {
+        std::vector<basic_node<B>*> leaves;
+        std::vector<std::vector<placement>> paths;
+        std::vector<B> states;
+        std::vector<board::piece_type> players;
+        std::vector<float> values;
+        auto searching = [&]() { return root.proof == 0 && (root.N == 0 || running(until)); };
+        while (searching()) {
+            leaves.clear();
+            paths.clear();
+            states.clear();
+            players.clear();
+            while (leaves.size() < batch && searching()) {
+                path.clear();
+                basic_node<B>* leaf = expand(select(tree));
+                simulations++;
+                if (leaf->terminated) {     // lost for the player to move, no need to evaluate
+                    update(leaf, leaf->who != root.who);
+                    mogi.katei.clear();
+                    collect(backup, leaf, leaf->who != root.who);
+                    continue;
                 }
+                for (basic_node<B>* n = leaf; n != NULL; n = n->parent)     n->update(virtual_loss(n));
+                pending++;
+                leaves.push_back(leaf);
+                paths.push_back(path);
+                states.push_back(leaf->current);
+                players.push_back(leaf->who);
             }
-            else {
-                while(1) {
-                    node* working = select();
-                    working = expand(working);
-                    mogi = simulate(working);
-                    update(working, mogi.shyoubu);
-                    if (time_up)   break;
-                }                
+            values.resize(leaves.size());
+            if (leaves.size())  eval->evaluate(states.data(), players.data(), leaves.size(), values.data());
+            for (size_t i = 0; i < leaves.size(); i++) {
+                double value = (leaves[i]->who == root.who) ? values[i] : 1 - values[i];
+                for (basic_node<B>* n = leaves[i]; n != NULL; n = n->revise(virtual_loss(n), value))    continue;
+                pending--;
+                path.swap(paths[i]);
+                mogi.katei.clear();
+                collect(backup, leaves[i], value);
+            }
+        }
+        if (progress)   progress(*this);
+        return decision();
+    }
+
+    /**
+     * the move to play, which is the best survivor of sequential halving if it is used
+     */
+    action::place decision() {
+        if (survivors.empty() || root.proof != 0)   return root.best_action();
+        return action::place(root.children[halve(1).front()]->parent_move, root.who);
+    }
+
+    /**
+     * return the root child to descend from by sequential halving, in turn among the survivors of the phase
+     * the shortlist is sampled once every root child is visited, and halved whenever the phase has spent its share
+     * return the root itself if all survivors are proven losses, so that the tree policy picks another move
+     */
+    basic_node<B>* candidate() {
+        if (survivors.empty()) {
+            std::extreme_value_distribution<double> noise;    // the Gumbel distribution, i.e., -log(-log(U))
+            gumbel.resize(root.num_of_child);
+            for (int i = 0; i < root.num_of_child; i++) {
+                gumbel[i] = noise(engine);
+                if (root.children[i]->proof == 0)   survivors.push_back(i);
             }
+            if (survivors.empty())  survivors.push_back(0);
+            survivors = halve(shortlist);   // sampled without replacement by the values of the first visits
+            phases = 0;
+            while ((size_t(1) << phases) < survivors.size())    phases++;
+            phase = 0;
+            schedule();
+        }
+        bool spent = cycles != 0 ? root.N >= phase_end : clock::now() >= phase_deadline;
+        if (spent && survivors.size() > 1) {
+            survivors = halve((survivors.size() + 1) / 2);
+            phase++;
+            schedule();
+        }
+        for (size_t skip = 0; skip < survivors.size(); skip++) {
+            basic_node<B>* child = root.children[survivors[turn++ % survivors.size()]];
+            if (child->proof == 0)  return child;   // a proven loss needs no more visits
         }
-        return root.best_action();
+        return &root;
+    }
+
+    /**
+     * give the phase an equal share of the remaining budget, at least one visit per survivor
+     */
+    void schedule() {
+        int left = std::max(phases - phase, 1);
+        phase_end = root.N + std::max<int>((cycles - root.N) / left, survivors.size());   // root.N counts the pending leaves
+        clock::time_point now = clock::now();
+        phase_deadline = now + (std::max(deadline, now) - now) / left;
+        turn = 0;
+    }
+
+    /**
+     * return the given number of the best survivors, ordered by g + sigma(Q) with sigma(Q) = (50 + max N) * Q,
+     * where Q is blended with the RAVE value as by rave_policy, and proven losses of the root player are ranked last
+     */
+    std::vector<int> halve(size_t keep) const {
+        int most = 0;
+        for (int i : survivors)     most = std::max(most, root.children[i]->N);
+        double blend = (tree == uct_rave) ? RAVE : 0;
+        std::vector<double> score(root.num_of_child);
+        for (int i : survivors) {
+            double Q = (1 - blend) * root.stats[root.stride + i] + blend * root.stats[root.stride * 3 + i];
+            score[i] = root.children[i]->proof == 1 ? -std::numeric_limits<double>::infinity() : gumbel[i] + (50 + most) * Q;
+        }
+        std::vector<int> best = survivors;
+        std::stable_sort(best.begin(), best.end(), [&score](int a, int b) { return score[a] > score[b]; });
+        best.resize(std::min(best.size(), keep));
+        return best;
+    }
+
+    /**
+     * the backup rules beyond update(), with the path from the root and the playout of the last simulation
+     */
+    void collect(mean_backup, basic_node<B>*, double) {}
+    void collect(rave_backup, basic_node<B>* leaf, double win) {
+        traverse(win, leaf);
+    }
+
+    /**
+     * return false once the search should stop by the condition or the stop flag,
+     * and report the progress if it is time to
+     */
+    bool running(count_limit) {
+        if (root.N >= cycles || stopped())  return false;
+        if (progress)   report(clock::now());
+        return true;
+    }
+    bool running(time_limit) {
+        if (stopped())  return false;
+        clock::time_point now = clock::now();
+        if (progress)   report(now);
+        return now < deadline;
+    }
+
+    bool stopped() const {
+        return stop != NULL && stop->load(std::memory_order_relaxed);
+    }
+
+    void report(clock::time_point now) {
+        if (now >= next_progress) {
+            progress(*this);
+            next_progress = now + progress_interval;
+        }
+    }
+
+    /**
+     * the value of a virtual loss on the edge to n, i.e., a loss for the player choosing n
+     */
+    double virtual_loss(const basic_node<B>* n) const {
+        return (n->parent != NULL && n->parent->who == root.who) ? 0 : 1;
+    }
+
+    /**
+     * rebuild the subtree of the i-th record below the node n, counting the bytes allocated
+     * return false if the records are inconsistent with the board
+     */
+    static bool restore(basic_node<B>& n, const tree_file::record* records, size_t i, size_t count, size_t& bytes) {
+        const tree_file::record& r = records[i];
+        n.N = r.N;
+        n.proof = r.proof;
+        n.terminated = r.terminated;
+        if (r.children == 0)    return r.first == 0;
+        if (r.first <= i || r.first + r.children > count || r.explored > r.children)    return false;
+        for (int k = 0; k < r.children; k++) {
+            B after = n.current;
+            if (after.place(typename B::point(records[r.first + k].move), n.who) != board::legal)   return false;
+            basic_node<B>* child = new basic_node<B>(after, n.child_type);
+            child->parent = &n;
+            child->parent_move = records[r.first + k].move;
+            child->index = k;
+            n.children.push_back(child);
+        }
+        n.num_of_child = r.children;
+        n.explored_child = r.explored;
+        n.stride = (n.num_of_child + 3) & ~3;
+        n.stats.assign(n.stride * 6, 0);
+        std::fill(n.child_N() + n.num_of_child, n.child_N() + n.stride, 1);
+        std::fill(n.child_P(), n.child_P() + n.num_of_child, 1.0 / n.num_of_child);    // the priors are not saved
+        std::fill(n.child_blocked() + n.num_of_child, n.child_blocked() + n.stride, -std::numeric_limits<double>::infinity());
+        bytes += n.footprint();
+        for (int k = 0; k < r.children; k++) {
+            const tree_file::record& c = records[r.first + k];
+            if (!restore(*n.children[k], records, r.first + k, count, bytes))  return false;
+            n.child_N()[k] = c.N;
+            n.child_Q()[k] = c.Q;
+            n.child_N_RAVE()[k] = c.N_RAVE;
+            n.child_Q_RAVE()[k] = c.Q_RAVE;
+            if (c.proof != 0)   n.child_blocked()[k] = -std::numeric_limits<double>::infinity();
+        }
+        return true;
+    }
+
+    /**
+     * collapse the least visited subtrees until the tree uses 3/4 of the memory limit
+     * a node is visited more than any of its children, so collapsing in ascending order of visits
+     * always releases the descendants before their ancestors
+     * the pass walks the whole tree, so the next one waits until the tree grows by a quarter of the limit again,
+     * which keeps the walks to O(1) per expanded node; if the limit cannot be met, that never happens, since
+     * expand() stops at the limit, i.e., the tree is frozen instead
+     */
+    void prune() {
+        std::vector<basic_node<B>*> expanded, stack(root.children.begin(), root.children.end());
+        while (stack.size()) {
+            basic_node<B>* n = stack.back();
+            stack.pop_back();
+            if (n->num_of_child == 0)   continue;
+            expanded.push_back(n);
+            stack.insert(stack.end(), n->children.begin(), n->children.end());
+        }
+        std::sort(expanded.begin(), expanded.end(), [](const basic_node<B>* a, const basic_node<B>* b) { return a->N < b->N; });
+        for (basic_node<B>* n : expanded) {
+            if (tree_bytes <= mem_limit / 4 * 3)   break;
+            tree_bytes -= n->collapse();
+        }
+        prune_at = std::max(mem_limit, tree_bytes + mem_limit / 4);
     }
 
 private:
-    node root;
+    basic_node<B> root;
     int cycles;     // number of simulations
     int think_time; // thinking_time in milisecond;
     double RAVE = 0;
+    playout policy;
+    reply_table replies;    // of the last good replies, if enabled by the playout policy
+    tree_policy tree;
+    double exploration = 0; // the default of the tree policy if 0
+    prior_features features;
+    bool priors = false;    // uniform priors if not set
+    double first_play_reduction = -1;
     std::vector<placement> path;
     sim_result mogi;
-};
\ No newline at end of file
+    size_t simulations = 0;
+    size_t tree_bytes = sizeof(basic_node<B>);
+    size_t mem_limit = 0;   // bytes, 0 for unlimited
+    bool mem_prune = true;
+    size_t prune_at = 0;    // the bytes to prune at, see prune()
+    basic_evaluator<B>* eval = NULL;    // rollouts if NULL
+    size_t batch = 1;
+    size_t pending = 0;     // leaves waiting for evaluation
+    size_t shortlist = 0;   // candidates of sequential halving at the root, disabled if 0
+    std::vector<int> survivors;     // the root children left by sequential halving, empty if not started
+    std::vector<double> gumbel;     // the noise of each root child
+    int phases = 0, phase = 0;
+    int phase_end = 0;      // the root visits to end the phase, for a count limit
+    clock::time_point phase_deadline;   // the time to end the phase, for a time limit
+    size_t turn = 0;
+
+    clock::time_point deadline;
+    const std::atomic<bool>* stop = NULL;
+    std::function<void(const basic_mcts&)> progress;
+    clock::duration progress_interval = std::chrono::milliseconds(100);
+    clock::time_point next_progress;
+};
+
+/**
+ * random (or pattern-weighted) rollouts as an evaluator, one playout per position
+ */
+template<class B>
+class basic_rollout_evaluator : public basic_evaluator<B> {
+public:
+    basic_rollout_evaluator(const playout& p = playout()) : policy(p) {}
+
+    virtual void evaluate(const B* states, const board::piece_type* who, size_t n, float* values) {
+        for (size_t i = 0; i < n; i++) {
+            values[i] = basic_node<B>(states[i], who[i]).simulate(who[i], policy).shyoubu;
+        }
+    }
+
+private:
+    playout policy;
+};
+
+typedef basic_node<board> node;
+typedef basic_mcts<board> mcts;
+typedef basic_rollout_evaluator<board> rollout_evaluator;
@@ -11,11 +11,140 @@
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <mutex>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistic.h"
+#include "dataset.h"
+#include "gtp.h"
+#include "tournament.h"
+#include "analysis.h"
+#include "server.h"
+#include "suite.h"
+#include "scheduler.h"
+
+/**
+ * play local games until the statistic is finished
+ */
+void play_games(statistic& stat, player& black, player& white, dataset_writer* data = nullptr) {
+	black.export_to(data);
+	white.export_to(data);
+	while (!stat.is_finished()) {
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+
+		stat.open_episode(black.name() + ":" + white.name());
+		episode& game = stat.back();
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (game.apply_action(move, who.simulations()) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		agent& win = game.last_turns(black, white);
+		stat.close_episode(win.name());
+		if (data) data->close_game(&win == &black ? board::black : board::white);
+
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+	}
+}
+
+/**
+ * play local games as tasks of the shared scheduler, with the players of each worker seeded distinctly,
+ * where the games are recorded in the order they end
+ */
+void play_scheduled_games(statistic& stat, size_t games, unsigned seed, const std::string& black_args, const std::string& white_args) {
+	auto base = [seed]() { return seed + (scheduler::worker_index() + 1) * 3; };
+	per_worker<player> blacks([&]() { return new player("name=black " + black_args + " role=black seed=" + std::to_string(base() + 1)); });
+	per_worker<player> whites([&]() { return new player("name=white " + white_args + " role=white seed=" + std::to_string(base() + 2)); });
+	std::mutex recording;
+	scheduler::shared().parallel_for(games, [&](size_t) {
+		player& black = blacks.local();
+		player& white = whites.local();
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+
+		episode game;
+		game.open_episode(black.name() + ":" + white.name());
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (game.apply_action(move, who.simulations()) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		agent& win = game.last_turns(black, white);
+		game.close_episode(win.name());
+
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+		std::lock_guard<std::mutex> lock(recording);
+		stat.add_episode(game);
+	});
+}
+
+/**
+ * fork the workers of sharded local games, each plays its share of the games with distinct seeds
+ * and writes its own record, then merge the records of the finished workers into stat
+ * the training samples of the workers, if exported, are concatenated into data_path
+ */
+void play_sharded_games(statistic& stat, size_t games, size_t limit, size_t shards, unsigned seed,
+		const std::string& black_args, const std::string& white_args, const std::string& prefix,
+		const std::string& data_path = "") {
+	std::vector<std::pair<pid_t, std::string>> workers;
+	for (size_t i = 0; i < shards; i++) {
+		size_t share = games / shards + (i < games % shards);
+		if (share == 0) continue;
+		std::string record = prefix + ".shard" + std::to_string(i);
+		std::cout.flush();
+		pid_t pid = fork();
+		if (pid == 0) { // worker: play silently, the merged statistic is reported by the launcher
+			std::cout.rdbuf(nullptr);
+			unsigned base = seed + i * 3;
+			engine.seed(base);
+			player black("name=black " + black_args + " role=black seed=" + std::to_string(base + 1));
+			player white("name=white " + white_args + " role=white seed=" + std::to_string(base + 2));
+			statistic part(share, 0, limit ? limit / shards + (i < limit % shards) : 0);
+			std::unique_ptr<dataset_writer> data;
+			if (data_path.size()) data.reset(new dataset_writer(record + ".data"));
+			play_games(part, black, white, data.get());
+			data.reset();
+			std::ofstream out(record, std::ios::out | std::ios::trunc);
+			out << part;
+			out.close();
+			_exit(out ? 0 : 1);
+		}
+		if (pid == -1) {
+			std::cerr << "cannot fork shard " << i << std::endl;
+			continue;
+		}
+		workers.emplace_back(pid, record);
+	}
+
+	std::ofstream data;
+	if (data_path.size()) data.open(data_path, std::ios::out | std::ios::binary | std::ios::trunc);
+	for (size_t i = 0; i < workers.size(); i++) {
+		int status = 0;
+		waitpid(workers[i].first, &status, 0);
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			statistic part(0);
+			part.load(workers[i].second);
+			stat.merge(part);
+			std::ifstream samples(workers[i].second + ".data", std::ios::in | std::ios::binary);
+			if (data_path.size() && samples.peek() != EOF) data << samples.rdbuf();
+		} else {
+			std::cerr << "shard " << workers[i].second << " failed, its games are dropped" << std::endl;
+		}
+		std::remove(workers[i].second.c_str());
+		std::remove((workers[i].second + ".data").c_str());
+	}
+}
 
 int main(int argc, const char* argv[]) {
 	std::cout << "HollowNoGo-Demo: ";
@@ -25,8 +154,16 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load, save;
+	std::string book_path, bench, export_path, corpus, socket_path, suite_path, suite_build;
+	size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t book_plies = 6, book_width = 3;
+	size_t shards = 1;
+	size_t suite_size = 30;
+	std::vector<std::string> configs; // of the tournament
+	sprt_test sprt;
+	unsigned seed = std::random_device()();
 	std::string name = "TCG-HollowNoGo-Demo", version = "2021"; // for GTP shell
-	bool summary = false, shell = false;
+	bool summary = false, shell = false, parallel = false, pin = false;
 	for (int i = 1; i < argc; i++) {
 		std::string para(argv[i]);
 		if (para.find("--total=") == 0) {
@@ -43,144 +180,148 @@ int main(int argc, const char* argv[]) {
 			load = para.substr(para.find("=") + 1);
 		} else if (para.find("--save=") == 0) {
 			save = para.substr(para.find("=") + 1);
+		} else if (para.find("--build-book=") == 0) {
+			book_path = para.substr(para.find("=") + 1);
+		} else if (para.find("--book-plies=") == 0) {
+			book_plies = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--book-width=") == 0) {
+			book_width = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--bench=") == 0) {
+			bench = para.substr(para.find("=") + 1);
+		} else if (para.find("--export=") == 0) {
+			export_path = para.substr(para.find("=") + 1);
+		} else if (para.find("--shards=") == 0) {
+			shards = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--suite=") == 0) {
+			suite_path = para.substr(para.find("=") + 1);
+		} else if (para.find("--build-suite=") == 0) {
+			suite_build = para.substr(para.find("=") + 1);
+		} else if (para.find("--suite-size=") == 0) {
+			suite_size = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--analyze=") == 0) {
+			corpus = para.substr(para.find("=") + 1);
+		} else if (para.find("--threads=") == 0) {
+			threads = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--pin") == 0) {
+			pin = true;
+		} else if (para.find("--parallel") == 0) {
+			parallel = true;
+		} else if (para.find("--player=") == 0) {
+			configs.push_back(para.substr(para.find("=") + 1));
+		} else if (para.find("--sprt=") == 0) {
+			std::stringstream ss(para.substr(para.find("=") + 1));
+			char comma;
+			ss >> sprt.elo0 >> comma >> sprt.elo1;
+			if (ss >> comma >> sprt.alpha) sprt.beta = sprt.alpha;
+			if (ss >> comma) ss >> sprt.beta;
+		} else if (para.find("--seed=") == 0) {
+			seed = std::stoul(para.substr(para.find("=") + 1));
 		} else if (para.find("--name=") == 0) {
 			name = para.substr(para.find("=") + 1);
 		} else if (para.find("--version=") == 0) {
 			version = para.substr(para.find("=") + 1);
 		} else if (para.find("--summary") == 0) {
 			summary = true;
+		} else if (para.find("--server=") == 0) {
+			socket_path = para.substr(para.find("=") + 1);
 		} else if (para.find("--shell") == 0) {
 			shell = true;
 		}
 	}
 
+	if (parallel && shards <= 1 && !shell && export_path.size()) // the samples are written by one game at a time
+		throw std::invalid_argument("--parallel cannot be used with --export, use --shards instead");
+
+	scheduler::configure(threads, pin); // the workers are started on the first use
+
+	if (book_path.size()) { // build an opening book with the search settings of black
+		player builder("name=book " + black_args + " role=black");
+		builder.build_book(book_path, book_plies, book_width);
+		return 0;
+	}
+
+	if (bench.size()) { // self-play benchmark of the search settings of black on another geometry
+		player bencher("name=bench " + black_args + " role=black");
+		bencher.benchmark(bench, total);
+		return 0;
+	}
+
+	if (suite_build.size()) { // collect reference positions from self-play of black and white, proven by the solver
+		player black("name=black " + black_args + " role=black");
+		player white("name=white " + white_args + " role=white");
+		suite_builder().build(suite_build, suite_size, seed, black, white, configs.size() ? configs[0] : "search=MCTS count=5000");
+		return 0;
+	}
+
+	if (suite_path.size()) { // time the player configs (or black) to solve the reference positions
+		std::ifstream in(suite_path, std::ios::in);
+		std::vector<suite_position> positions;
+		for (suite_position p; in >> p; ) positions.push_back(p);
+		if (positions.empty()) throw std::invalid_argument("invalid suite: " + suite_path);
+		suite_runner runner(positions);
+		if (configs.empty()) configs.push_back(black_args);
+		for (const std::string& config : configs) runner.run(config, seed);
+		return 0;
+	}
+
+	if (corpus.size()) { // analyze the positions of the corpus with the search settings of black
+		std::ifstream in(corpus, std::ios::in);
+		position_analysis analysis;
+		std::cerr << analysis.load(in) << " positions" << std::endl;
+		analysis.run(black_args, seed);
+		if (save.size()) {
+			std::ofstream out(save, std::ios::out | std::ios::trunc);
+			analysis.write(out);
+		} else {
+			analysis.write(std::cout);
+		}
+		return 0;
+	}
+
+	if (configs.size() >= 2) { // round-robin tournament of the player configs
+		tournament(configs, total, shards, seed, sprt).run();
+		return 0;
+	}
+
+	if (socket_path.size()) { // serve GTP sessions on a Unix domain socket, with players of the black and white settings
+		gtp_server(socket_path, black_args, white_args, name, version).run();
+		return 0;
+	}
+
 	statistic stat(total, block, limit);
 
-	if (load.size()) {
-		std::ifstream in(load, std::ios::in);
-		in >> stat;
-		in.close();
+	if (load.size()) { // load one record, or merge several records separated by commas
+		std::stringstream paths(load);
+		for (std::string path; std::getline(paths, path, ','); ) {
+			statistic part(0);
+			part.load(path, threads);
+			stat.merge(part);
+		}
+		if (load.find(',') != std::string::npos) stat.show_blocks();
 		summary |= stat.is_finished();
 	}
 
+	if (shards > 1 && !shell) { // launch sharded local games in worker processes
+		size_t games = stat.is_finished() ? 0 : total - stat.episodes();
+		play_sharded_games(stat, games, limit, shards, seed, black_args, white_args,
+		                   save.size() ? save : "/tmp/nogo." + std::to_string(getpid()), export_path);
+		stat.show_blocks();
+	}
+
+	if (parallel && shards <= 1 && !shell) { // launch local games on the workers of the scheduler
+		play_scheduled_games(stat, stat.is_finished() ? 0 : total - stat.episodes(), seed, black_args, white_args);
+	}
+
 	player black("name=black " + black_args + " role=black");
 	player white("name=white " + white_args + " role=white");
 
-	if (!shell) { // launch standard local games
-		while (!stat.is_finished()) {
-			black.open_episode("~:" + white.name());
-			white.open_episode(black.name() + ":~");
-
-			stat.open_episode(black.name() + ":" + white.name());
-			episode& game = stat.back();
-			while (true) {
-				agent& who = game.take_turns(black, white);
-				action move = who.take_action(game.state());
-				if (game.apply_action(move) != true) break;
-				if (who.check_for_win(game.state())) break;
-			}
-			agent& win = game.last_turns(black, white);
-			stat.close_episode(win.name());
-
-			black.close_episode(win.name());
-			white.close_episode(win.name());
+	if (!shell) { // launch standard local games, unless they are played by the shards or the scheduler
+		if (shards <= 1) {
+			std::unique_ptr<dataset_writer> data(export_path.size() ? new dataset_writer(export_path) : nullptr);
+			play_games(stat, black, white, data.get());
 		}
 	} else { // launch GTP shell
-		for (std::string command; std::getline(std::cin, command); ) {
-			if (command.back() == '\r') command.pop_back();
-			if (command.empty()) continue;
-
-			std::vector<std::string> args;
-			std::istringstream iss(command);
-			for (std::string s; getline(iss, s, ' '); args.push_back(s));
-
-			std::string reply;
-			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
-				if (!stat.is_episode_ongoing()) { // should open an episode
-					black.open_episode("~:" + white.name());
-					white.open_episode(black.name() + ":~");
-					stat.open_episode(black.name() + ":" + white.name());
-				}
-
-				episode& game = stat.back();
-				agent& who = game.take_turns(black, white);
-				if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
-					std::cout << "= " << "resign" << std::endl << std::endl;
-					// show the error message and terminate the shell
-					std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
-					std::cerr << "current state, "
-					          << who.role() << " to play: " << std::endl << game.state();
-					break;
-				}
-				if (args[0] == "play") { // play a move
-					std::string types = "?bw"; // black == 1, white == 2
-					action::place move(args[2], types.find(who.role()[0]));
-					if (game.apply_action(move) != true) { // remote plays an illegal move?!
-						std::cout << "= " << "resign" << std::endl << std::endl;
-						// show the error message and terminate the shell
-						std::cerr << who.role() << " plays an illegal action!" << std::endl;
-						const char* reason[] = {
-							"legal",
-							"illegal_turn",
-							"illegal_pass",
-							"illegal_out_of_range",
-							"illegal_not_empty",
-							"illegal_suicide",
-							"illegal_take",
-							"unknown",
-						};
-						std::cerr << "current state: " << std::endl << game.state();
-						int code = move.apply(game.state());
-						std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
-						std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
-						break;
-					}
-				} else if (args[0] == "genmove") { // generate a move and play
-					action::place move = who.take_action(game.state());
-					if (game.apply_action(move) == true) {
-						reply = move.position();
-					} else { // I have no legal move to play
-						reply = "resign";
-					}
-				}
-
-			} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
-				if (stat.is_episode_ongoing()) { // should close an opened episode
-					agent& win = stat.back().last_turns(black, white);
-					stat.close_episode(win.name());
-					black.close_episode(win.name());
-					white.close_episode(win.name());
-				}
-				if (args[0] == "quit") break; // quit GTP shell
-
-			} else if (args[0] == "showboard") { // print the board
-				std::stringstream buf;
-				buf << (stat.is_episode_ongoing() ? stat.back().state() : board());
-				reply = "\n" + buf.str();
-				reply.pop_back(); // remove a new line
-
-			} else if (args[0] == "boardsize") { // set the board size
-				size_t size = std::stoul(args[1]);
-				if (size != board::size_x || size != board::size_y) {
-					std::cerr << "board size mismatch: " << args[1] << std::endl;
-				}
-				if (size > board::size_x || size > board::size_y) break;
-
-			} else if (args[0] == "name") { // report the name of the program
-				reply = name;
-			} else if (args[0] == "version") { // report the version number of the program
-				reply = version;
-			} else if (args[0] == "protocol_version") { // report GTP protocol version
-				reply = "2";
-			} else if (args[0] == "list_commands") { // print supported commands
-				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
-				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
-			} else {
-				reply = "unknown command";
-			}
-
-			std::cout << "= " << reply << std::endl << std::endl;
-		}
+		gtp_shell(stat, black, white, name, version).run(std::cin, std::cout);
 	}
 
 	if (summary) {
@@ -0,0 +1,252 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * pattern.h: 3x3 pattern weights for heavy playouts
+ */
+
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include "board.h"
+
+/**
+ * the 3x3 pattern of a position is coded by its 8 neighbors, 2 bits each
+ *
+ *   0 1 2
+ *   3 . 4   (neighbor 7 - k is the opposite of neighbor k)
+ *   5 6 7
+ *
+ * with empty == 0, black == 1, white == 2, and border (edge or hollow) == 3
+ */
+class pattern_table {
+public:
+	typedef uint16_t code;
+	static constexpr int dx[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+	static constexpr int dy[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+
+	/**
+	 * default weights: avoid filling the own safe points, and prefer the points next to the opponent
+	 */
+	pattern_table() {
+		for (unsigned c = 0; c < 65536u; c++) {
+			float w = 1;
+			bool eye = true, touch = false;
+			for (int k : { 1, 3, 4, 6 }) {
+				unsigned v = (c >> (k * 2)) & 3u;
+				eye &= (v == board::black || v == board::hollow);
+				touch |= (v == board::white);
+			}
+			if (eye) w = 0.05f;
+			else if (touch) w = 1.5f;
+			assign(c, w);
+		}
+	}
+
+	/**
+	 * load weights from a file, each line is a pattern of its 8 neighbors and a weight, e.g.,
+	 *   .X.X X.X. 0.05
+	 * where '.' is empty, 'X' is the player to move, 'O' is the opponent, '#' is border
+	 * the patterns are expanded to all 8 symmetries, and lines begin with "//" are comments
+	 */
+	pattern_table(const std::string& path) : pattern_table() {
+		std::ifstream in(path);
+		if (!in) throw std::invalid_argument("invalid patterns: " + path);
+		for (std::string line; std::getline(in, line); ) {
+			if (line.empty() || line.find("//") == 0) continue;
+			std::string shape, token;
+			std::stringstream ss(line);
+			float w;
+			while (shape.size() < 8 && ss >> token) shape += token;
+			if (shape.size() != 8 || !(ss >> w)) throw std::invalid_argument("invalid pattern: " + line);
+			code c = 0;
+			for (int k = 0; k < 8; k++) {
+				size_t v = std::string(".XO#").find(shape[k]);
+				if (v == std::string::npos) throw std::invalid_argument("invalid pattern: " + line);
+				c |= v << (k * 2);
+			}
+			for (int s = 0; s < 8; s++) assign(symmetry(c, s), w);
+		}
+	}
+
+	/**
+	 * the weight of the pattern for who to play at the center
+	 */
+	float weight(code c, unsigned who) const {
+		return weights[who - 1][c];
+	}
+
+	/**
+	 * map the pattern through symmetry s, bit 0 transposes, bit 1 reflects x, bit 2 reflects y
+	 */
+	static code symmetry(code c, int s) {
+		code r = 0;
+		for (int k = 0; k < 8; k++) {
+			int x = dx[k], y = dy[k];
+			if (s & 1) std::swap(x, y);
+			if (s & 2) x = -x;
+			if (s & 4) y = -y;
+			r |= ((c >> (k * 2)) & 3u) << (index(x, y) * 2);
+		}
+		return r;
+	}
+
+	static int index(int x, int y) {
+		int k = (y + 1) * 3 + (x + 1);
+		return k < 4 ? k : k - 1;
+	}
+
+private:
+	/**
+	 * set the weight of pattern c for black, and the color-swapped pattern for white
+	 */
+	void assign(code c, float w) {
+		code swapped = 0;
+		for (int k = 0; k < 8; k++) {
+			unsigned v = (c >> (k * 2)) & 3u;
+			if (v == board::black || v == board::white) v = 3u - v;
+			swapped |= v << (k * 2);
+		}
+		w = std::max(w, 1e-4f); // a legal move must remain possible to sample
+		weights[0][c] = w;
+		weights[1][swapped] = w;
+	}
+
+private:
+	std::array<std::array<float, 65536>, 2> weights;
+};
+
+constexpr int pattern_table::dx[8];
+constexpr int pattern_table::dy[8];
+
+/**
+ * Fenwick tree for sampling positions by weight in O(log n)
+ */
+class weighted_sampler {
+public:
+	weighted_sampler(size_t n = 0) : tree(n + 1, 0), value(n, 0) {}
+
+	void set(int i, double w) {
+		double delta = w - value[i];
+		value[i] = w;
+		for (int j = i + 1; j < int(tree.size()); j += j & -j) tree[j] += delta;
+	}
+	double get(int i) const { return value[i]; }
+
+	double total() const {
+		double sum = 0;
+		for (int j = value.size(); j > 0; j -= j & -j) sum += tree[j];
+		return sum;
+	}
+
+	/**
+	 * return the position whose cumulative weight covers r, with 0 <= r < total()
+	 */
+	int sample(double r) const {
+		int pos = 0, step = 1;
+		while (step * 2 < int(tree.size())) step *= 2;
+		for (; step; step /= 2) {
+			if (pos + step < int(tree.size()) && tree[pos + step] <= r) {
+				pos += step;
+				r -= tree[pos];
+			}
+		}
+		return std::min<int>(pos, value.size() - 1);
+	}
+
+private:
+	std::vector<double> tree;
+	std::vector<double> value;
+};
+
+/**
+ * board with the pattern code of every position maintained incrementally,
+ * and the playout weights of both players ready to sample
+ * the 3x3 neighborhoods come from the geometry table of the board, in the same order as the pattern code
+ */
+template<class B>
+class basic_pattern_board {
+public:
+	basic_pattern_board(const B& b, const pattern_table& table) : state(b), table(table) {
+		for (int i = 0; i < B::cells; i++) {
+			pattern[i] = 0;
+			for (int k = 0; k < 8; k++)
+				pattern[i] |= state(B::table.around[i][k]) << (k * 2);
+		}
+		for (unsigned who = board::black; who <= board::white; who++) {
+			samplers[who - 1] = weighted_sampler(B::cells);
+			for (int i = 0; i < B::cells; i++)
+				if (state(i) == board::empty) samplers[who - 1].set(i, table.weight(pattern[i], who));
+		}
+	}
+
+	/**
+	 * play a move for who sampled by weight, return the position or -1 if who has no legal move
+	 * a position illegal for who stays illegal in NoGo, so it is dropped once found
+	 */
+	template<typename random>
+	int play(unsigned who, random& engine) {
+		weighted_sampler& sampler = samplers[who - 1];
+		for (double total; (total = sampler.total()) > 1e-6; ) {
+			int pos = sampler.sample(std::uniform_real_distribution<double>(0, total)(engine));
+			if (sampler.get(pos) == 0) { // rounding of the sums
+				sampler = rebuild(who);
+				continue;
+			}
+			if (state.place(typename B::point(pos), who) != board::legal) {
+				sampler.set(pos, 0);
+				continue;
+			}
+			update(pos, who);
+			return pos;
+		}
+		return -1;
+	}
+
+	/**
+	 * play the given move for who if it is legal, return false otherwise
+	 */
+	bool play_at(int pos, unsigned who) {
+		if (state(pos) != board::empty) return false;
+		if (state.place(typename B::point(pos), who) != board::legal) {
+			samplers[who - 1].set(pos, 0); // stays illegal, as in play()
+			return false;
+		}
+		update(pos, who);
+		return true;
+	}
+
+	const B& current() const { return state; }
+
+private:
+	void update(int pos, unsigned who) {
+		samplers[0].set(pos, 0);
+		samplers[1].set(pos, 0);
+		for (int k = 0; k < 8; k++) {
+			int i = B::table.around[pos][k];
+			if (state(i) != board::empty) continue;
+			pattern[i] = (pattern[i] & ~(3u << ((7 - k) * 2))) | (who << ((7 - k) * 2));
+			for (unsigned c = board::black; c <= board::white; c++)
+				if (samplers[c - 1].get(i) != 0) samplers[c - 1].set(i, table.weight(pattern[i], c));
+		}
+	}
+
+	weighted_sampler rebuild(unsigned who) const {
+		weighted_sampler fresh(B::cells);
+		for (int i = 0; i < B::cells; i++)
+			if (samplers[who - 1].get(i) != 0) fresh.set(i, samplers[who - 1].get(i));
+		return fresh;
+	}
+
+private:
+	B state;
+	const pattern_table& table;
+	std::array<pattern_table::code, B::cells> pattern;
+	std::array<weighted_sampler, 2> samplers;
+};
+
+typedef basic_pattern_board<board> pattern_board;
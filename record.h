@@ -0,0 +1,115 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * record.h: Zero-copy parsing of text records over memory-mapped files
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * a range of characters [first, last) in a buffer which outlives it, e.g., a line of a mapped file
+ */
+struct text_range {
+	const char* first;
+	const char* last;
+
+	text_range(const char* first = nullptr, const char* last = nullptr) : first(first), last(last) {}
+
+	size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+	bool starts_with(const char* prefix) const {
+		size_t n = std::strlen(prefix);
+		return size() >= n && std::memcmp(first, prefix, n) == 0;
+	}
+	/**
+	 * the position of the text in the range, or last if not found
+	 */
+	const char* find(const char* text) const {
+		return std::search(first, last, text, text + std::strlen(text));
+	}
+	std::string str() const { return std::string(first, last); }
+};
+
+/**
+ * read a decimal number at p, moving p past it, as istream >> std::dec would (leading spaces and a sign allowed)
+ */
+inline bool parse_number(const char*& p, const char* last, time_t& value) {
+	while (p != last && (*p == ' ' || *p == '\t')) p++;
+	bool negative = (p != last && (*p == '-' || *p == '+')) ? (*p++ == '-') : false;
+	if (p == last || *p < '0' || *p > '9') return false;
+	time_t v = 0;
+	for (; p != last && *p >= '0' && *p <= '9'; p++) v = v * 10 + (*p - '0');
+	value = negative ? -v : v;
+	return true;
+}
+
+/**
+ * a file mapped read-only as a whole, empty if it does not exist
+ */
+class mapped_file {
+public:
+	mapped_file(const std::string& path) : base(nullptr), length(0) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd == -1) return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED) {
+				base = static_cast<const char*>(map);
+				length = st.st_size;
+				madvise(map, length, MADV_SEQUENTIAL);
+			}
+		}
+		close(fd);
+	}
+	~mapped_file() {
+		if (base) munmap(const_cast<char*>(base), length);
+	}
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator =(const mapped_file&) = delete;
+
+	bool is_open() const { return base != nullptr; }
+	text_range text() const { return text_range(base, base + length); }
+
+	/**
+	 * split the text into at most n chunks of about equal size, each ending at a line boundary
+	 */
+	static std::vector<text_range> split(text_range text, size_t n) {
+		std::vector<text_range> chunks;
+		const char* first = text.first;
+		for (size_t i = 1; first != text.last; i++) {
+			const char* last = (i < n) ? text.first + text.size() * i / n : text.last;
+			if (last < first) continue;
+			last = std::find(last, text.last, '\n');
+			if (last != text.last) last++;
+			chunks.emplace_back(first, last);
+			first = last;
+		}
+		return chunks;
+	}
+
+	/**
+	 * call the visitor with each line of the text, without the line break, until it returns false
+	 */
+	template<class visitor>
+	static void lines(text_range text, visitor visit) {
+		for (const char* p = text.first; p != text.last; ) {
+			const char* end = std::find(p, text.last, '\n');
+			if (!visit(text_range(p, end))) return;
+			p = (end != text.last) ? end + 1 : end;
+		}
+	}
+
+private:
+	const char* base;
+	size_t length;
+};
@@ -0,0 +1,272 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * scheduler.h: Work-stealing scheduler shared by the parallel workloads of the process
+ */
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <pthread.h>
+#include <sched.h>
+#include "mcts.h"
+
+/**
+ * a fixed number of workers, each with its own deque of tasks and its own random engine (the engine of mcts.h,
+ * seeded distinctly per worker), optionally pinned to the allowed cpus in turn
+ *
+ * a task submitted by a worker goes to the back of its own deque, and one from another thread to the deques in turn;
+ * a worker runs the tasks at the back of its own deque first, and steals from the front of the others when it is empty,
+ * so that the tasks spawned by a task stay with the same worker and its warm caches
+ *
+ * the self-play games, the searches of the server sessions, the analysis, the suite and the loading of records
+ * all submit to the shared scheduler, so that they never run more than --threads tasks at once together
+ */
+class scheduler {
+public:
+	/**
+	 * a set of tasks to wait for together, which keeps the first exception thrown by them
+	 */
+	class group {
+	friend class scheduler;
+	public:
+		group() : pending(0) {}
+	private:
+		std::atomic<size_t> pending;
+		std::exception_ptr error;
+	};
+
+	scheduler(size_t threads, bool pin = false, unsigned seed = std::random_device()())
+		: workers(std::max<size_t>(threads, 1)), queued(0), next(0), done(false) {
+		if (pin) cpus = allowed_cpus();
+		for (size_t i = 0; i < workers.size(); i++) {
+			workers[i].reset(new worker(seed + i));
+			workers[i]->thread = std::thread(&scheduler::work, this, i);
+		}
+	}
+	~scheduler() {
+		{
+			std::lock_guard<std::mutex> lock(sleeping);
+			done = true;
+		}
+		wake.notify_all();
+		for (std::unique_ptr<worker>& w : workers) w->thread.join();
+	}
+	scheduler(const scheduler&) = delete;
+	scheduler& operator =(const scheduler&) = delete;
+
+	/**
+	 * the scheduler of the process, created by the first call with the settings of configure()
+	 */
+	static scheduler& shared() {
+		static scheduler instance(settings().threads, settings().pin);
+		return instance;
+	}
+	static void configure(size_t threads, bool pin = false) {
+		settings().threads = threads;
+		settings().pin = pin;
+	}
+
+	size_t size() const { return workers.size(); }
+
+	/**
+	 * the index of the calling worker in its scheduler, or -1 if the caller is not a worker
+	 */
+	static int worker_index() {
+		return current().index;
+	}
+
+public:
+	void submit(std::function<void()> task, group* g = nullptr) {
+		if (g) g->pending++;
+		worker& w = (current().owner == this) ? *workers[current().index] : *workers[next++ % workers.size()];
+		{
+			std::lock_guard<std::mutex> lock(w.mutex);
+			w.tasks.emplace_back(std::move(task), g);
+		}
+		queued++;
+		{
+			std::lock_guard<std::mutex> lock(sleeping);
+		}
+		wake.notify_one();
+	}
+
+	/**
+	 * wait until the tasks of the group are finished, then rethrow the first exception of them if any
+	 * a worker keeps running the queued tasks while waiting, so a task may wait for the tasks it spawns
+	 */
+	void wait(group& g) {
+		bool helping = current().owner == this;
+		while (g.pending) {
+			task t;
+			if (helping && take(current().index, t)) {
+				run(t);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleeping);
+			if (helping) wake.wait(lock, [&]() { return g.pending == 0 || queued != 0; });
+			else finished.wait(lock, [&]() { return g.pending == 0; });
+		}
+		if (g.error) {
+			std::exception_ptr error = g.error;
+			g.error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	/**
+	 * call f(i) for i in [0, n) as n tasks, and wait for all of them
+	 */
+	template<class F>
+	void parallel_for(size_t n, F f) {
+		group g;
+		for (size_t i = 0; i < n; i++) submit([&f, i]() { f(i); }, &g);
+		wait(g);
+	}
+
+private:
+	typedef std::pair<std::function<void()>, group*> task;
+
+	struct worker {
+		worker(unsigned seed) : random(seed), seed(seed) {}
+		std::mutex mutex;                // guards the tasks
+		std::deque<task> tasks;
+		std::default_random_engine random; // to pick the victims of stealing
+		unsigned seed;
+		std::thread thread;
+	};
+
+	struct identity {
+		scheduler* owner = nullptr;
+		int index = -1;
+	};
+	static identity& current() {
+		static thread_local identity id;
+		return id;
+	}
+
+	struct config {
+		size_t threads = std::max(1u, std::thread::hardware_concurrency());
+		bool pin = false;
+	};
+	static config& settings() {
+		static config c;
+		return c;
+	}
+
+	void work(size_t i) {
+		current().owner = this;
+		current().index = i;
+		engine.seed(workers[i]->seed);
+		if (cpus.size()) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpus[i % cpus.size()], &set);
+			pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		}
+		while (true) {
+			task t;
+			if (take(i, t)) {
+				run(t);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleeping);
+			wake.wait(lock, [this]() { return queued != 0 || done; });
+			if (queued == 0 && done) break;
+		}
+	}
+
+	/**
+	 * take a task from the back of the own deque, or steal one from the front of another, starting at a random victim
+	 */
+	bool take(size_t i, task& t) {
+		if (queued == 0) return false;
+		if (pop(*workers[i], t, false)) return true;
+		size_t n = workers.size();
+		size_t first = std::uniform_int_distribution<size_t>(0, n - 1)(workers[i]->random);
+		for (size_t k = 0; k < n; k++) {
+			size_t victim = (first + k) % n;
+			if (victim != i && pop(*workers[victim], t, true)) return true;
+		}
+		return false;
+	}
+	bool pop(worker& w, task& t, bool front) {
+		std::lock_guard<std::mutex> lock(w.mutex);
+		if (w.tasks.empty()) return false;
+		if (front) {
+			t = std::move(w.tasks.front());
+			w.tasks.pop_front();
+		} else {
+			t = std::move(w.tasks.back());
+			w.tasks.pop_back();
+		}
+		queued--;
+		return true;
+	}
+
+	void run(task& t) {
+		group* g = t.second;
+		try {
+			t.first();
+		} catch (...) {
+			if (!g) throw;
+			std::lock_guard<std::mutex> lock(sleeping);
+			if (!g->error) g->error = std::current_exception();
+		}
+		if (g && --g->pending == 0) {
+			{
+				std::lock_guard<std::mutex> lock(sleeping);
+			}
+			wake.notify_all();
+			finished.notify_all();
+		}
+	}
+
+	static std::vector<int> allowed_cpus() {
+		std::vector<int> list;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) != 0) return list;
+		for (int c = 0; c < CPU_SETSIZE; c++)
+			if (CPU_ISSET(c, &set)) list.push_back(c);
+		return list;
+	}
+
+private:
+	std::vector<std::unique_ptr<worker>> workers;
+	std::vector<int> cpus; // to pin the workers in turn, empty if not pinned
+	std::atomic<size_t> queued;
+	std::atomic<size_t> next;
+	std::mutex sleeping; // guards the waits of the idle workers and the waiters of groups
+	std::condition_variable wake;
+	std::condition_variable finished;
+	bool done;
+};
+
+/**
+ * an object per worker of a scheduler (and one for a single outside thread), made on the first use by each worker,
+ * e.g., the players of the workers, each used by one task at a time (a player builds a new search tree per move)
+ */
+template<class T>
+class per_worker {
+public:
+	per_worker(std::function<T*()> make, const scheduler& owner = scheduler::shared()) : make(make), slots(owner.size() + 1) {}
+
+	T& local() {
+		size_t i = scheduler::worker_index() + 1;
+		std::unique_ptr<T>& slot = slots[i < slots.size() ? i : 0];
+		if (!slot) slot.reset(make());
+		return *slot;
+	}
+
+private:
+	std::function<T*()> make;
+	std::vector<std::unique_ptr<T>> slots;
+};
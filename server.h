@@ -0,0 +1,267 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * server.h: GTP server of many sessions over a Unix domain socket, multiplexed by epoll
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <ostream>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "agent.h"
+#include "statistic.h"
+#include "gtp.h"
+#include "scheduler.h"
+
+/**
+ * serve independent GTP sessions, one per connection to the socket, each with its own board, players and statistic
+ * the players of all sessions share the read-only resources loaded from files, see shared_resource()
+ *
+ * the connections are read by a single thread with epoll, which only queues the command lines of each session,
+ * and the commands of a session are executed in order as tasks of the shared scheduler, so at most as many searches
+ * as its workers run at once; stop (or any command during lz-analyze) ends the running search of the session at once, as gtp_shell
+ */
+class gtp_server {
+public:
+	gtp_server(const std::string& path, const std::string& black_args, const std::string& white_args,
+	           const std::string& name, const std::string& version)
+		: path(path), black_args(black_args), white_args(white_args), name(name), version(version) {}
+
+	/**
+	 * serve until killed
+	 */
+	void run() {
+		sockaddr_un addr;
+		std::memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(addr.sun_path)) throw std::invalid_argument("invalid socket path: " + path);
+		std::strcpy(addr.sun_path, path.c_str());
+		listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		unlink(path.c_str());
+		if (listener == -1 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 || listen(listener, 128) == -1)
+			throw std::runtime_error("cannot listen on " + path + ": " + std::strerror(errno));
+		epoll = epoll_create1(EPOLL_CLOEXEC);
+		wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		watch(listener, EPOLLIN, EPOLL_CTL_ADD);
+		watch(wakeup, EPOLLIN, EPOLL_CTL_ADD);
+		std::cerr << "serving on " << path << std::endl;
+
+		epoll_event events[64];
+		while (true) {
+			int n = epoll_wait(epoll, events, 64, -1);
+			for (int i = 0; i < n; i++) {
+				int fd = events[i].data.fd;
+				if (fd == listener) {
+					accept_sessions();
+				} else if (fd == wakeup) {
+					uint64_t count;
+					if (read(wakeup, &count, sizeof(count)) == -1) continue;
+					close_finished();
+				} else if (sessions.count(fd)) {
+					session& s = *sessions[fd];
+					if (events[i].events & EPOLLOUT) s.flush();
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) receive(s);
+				}
+			}
+		}
+	}
+
+private:
+	/**
+	 * a connection, whose output stream sends to the socket as much as it can at each flush,
+	 * and leaves the rest to be sent when the socket is writable again
+	 */
+	struct session : public std::streambuf {
+		session(gtp_server& server, int fd)
+			: server(server), fd(fd), stat(size_t(-1), size_t(-1), 1), // keep only the last game, and never show the blocks
+			  black("name=black " + server.black_args + " role=black"),
+			  white("name=white " + server.white_args + " role=white"),
+			  shell(stat, black, white, server.name, server.version), out(this) {
+			shell.search_in_place(true, [this](const std::function<bool(const std::string&)>& test) {
+				std::lock_guard<std::mutex> lock(mutex);
+				return closing || std::any_of(lines.begin(), lines.end(), test);
+			});
+		}
+
+		void flush() {
+			std::lock_guard<std::mutex> lock(sending);
+			while (output.size()) {
+				ssize_t sent = send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+				if (sent <= 0) break;
+				output.erase(0, sent);
+			}
+			if (output.size() && errno != EAGAIN && errno != EWOULDBLOCK) output.clear(); // the peer is gone
+			bool waiting = output.size() != 0;
+			if (waiting != blocked) server.watch(fd, waiting ? EPOLLIN | EPOLLRDHUP | EPOLLOUT : EPOLLIN | EPOLLRDHUP, EPOLL_CTL_MOD);
+			blocked = waiting;
+		}
+
+		virtual int overflow(int c) {
+			if (c != EOF) {
+				std::lock_guard<std::mutex> lock(sending);
+				output.push_back(char(c));
+			}
+			return c;
+		}
+		virtual std::streamsize xsputn(const char* s, std::streamsize n) {
+			std::lock_guard<std::mutex> lock(sending);
+			output.append(s, n);
+			return n;
+		}
+		virtual int sync() {
+			flush();
+			return 0;
+		}
+
+		gtp_server& server;
+		int fd;
+		statistic stat;
+		player black, white;
+		gtp_shell shell;
+		std::ostream out;
+
+		std::mutex mutex;               // guards the fields below, shared by the reader and the executor
+		std::string input;              // the partial line read, only by the reader
+		std::deque<std::string> lines;  // the command lines to execute
+		bool scheduled = false;         // an executor is running the lines
+		bool closing = false;           // no more lines will come
+		bool finished = false;          // passed to the reader to be closed
+
+		std::mutex sending;             // guards the output
+		std::string output;
+		bool blocked = false;           // waiting for the socket to be writable
+	};
+
+	void watch(int fd, uint32_t events, int op) {
+		epoll_event ev;
+		std::memset(&ev, 0, sizeof(ev));
+		ev.events = events;
+		ev.data.fd = fd;
+		epoll_ctl(epoll, op, fd, &ev);
+	}
+
+	void accept_sessions() {
+		int fd;
+		while ((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+			try {
+				sessions[fd].reset(new session(*this, fd));
+				watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+			} catch (std::exception& e) {
+				std::cerr << "cannot open a session: " << e.what() << std::endl;
+				sessions.erase(fd);
+				close(fd);
+			}
+		}
+	}
+
+	/**
+	 * read the command lines of the session, and schedule the session to execute them
+	 */
+	void receive(session& s) {
+		char buffer[4096];
+		ssize_t n;
+		bool hangup = false;
+		while ((n = recv(s.fd, buffer, sizeof(buffer), 0)) != 0) {
+			if (n == -1) {
+				hangup = (errno != EAGAIN && errno != EWOULDBLOCK);
+				break;
+			}
+			s.input.append(buffer, n);
+		}
+		if (n == 0) hangup = true;
+
+		std::lock_guard<std::mutex> lock(s.mutex);
+		for (size_t end; (end = s.input.find('\n')) != std::string::npos; ) {
+			std::string line = s.input.substr(0, end);
+			s.input.erase(0, end + 1);
+			if (s.closing) continue;
+			s.lines.push_back(line);
+			s.shell.interrupt(line); // or the search about to start sees the line, see gtp_shell::search_in_place()
+		}
+		if (hangup && !s.closing) {
+			s.shell.interrupt("stop");
+			s.closing = true;
+			watch(s.fd, 0, EPOLL_CTL_DEL);
+		}
+		if ((s.lines.size() || (s.closing && !s.finished)) && !s.scheduled) {
+			s.scheduled = true;
+			scheduler::shared().submit([this, &s]() { execute(s); });
+		}
+	}
+
+	/**
+	 * execute the queued lines of the session in order, by a worker of the scheduler
+	 * once the session is closing and all its lines are done, pass it to the reader to be closed
+	 */
+	void execute(session& s) {
+		while (true) {
+			std::string line;
+			bool done = false;
+			{
+				std::lock_guard<std::mutex> lock(s.mutex);
+				if (s.lines.empty()) {
+					s.scheduled = false;
+					done = s.finished = s.closing;
+					if (!done) return;
+				} else {
+					line = std::move(s.lines.front());
+					s.lines.pop_front();
+				}
+			}
+			if (done) { // the session is no longer touched after it is passed, since the reader may close it at once
+				s.flush();
+				int fd = s.fd;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					finished.push_back(fd);
+				}
+				uint64_t one = 1;
+				if (write(wakeup, &one, sizeof(one)) == -1) std::cerr << "cannot wake up the server" << std::endl;
+				return;
+			}
+			if (!s.shell.command(line, s.out)) { // quit
+				std::lock_guard<std::mutex> lock(s.mutex);
+				s.lines.clear();
+				s.closing = true;
+			}
+		}
+	}
+
+	void close_finished() {
+		std::vector<int> fds;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			fds.swap(finished);
+		}
+		for (int fd : fds) {
+			watch(fd, 0, EPOLL_CTL_DEL); // if the session quit by itself
+			sessions.erase(fd);
+			close(fd);
+		}
+	}
+
+private:
+	std::string path;
+	std::string black_args, white_args;
+	std::string name, version;
+	int listener = -1, epoll = -1, wakeup = -1;
+	std::map<int, std::unique_ptr<session>> sessions; // by the socket, only touched by the reader
+
+	std::mutex mutex;       // guards the finished sessions
+	std::vector<int> finished;
+};
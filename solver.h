@@ -0,0 +1,119 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * solver.h: Exact endgame solver by iterative deepening alpha-beta search
+ */
+
+#pragma once
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+
+/**
+ * since the side without legal moves loses, every position is either a win or a loss,
+ * so the alpha-beta window collapses to (loss, win) and a depth-limited search may also
+ * end with unknown
+ */
+template<class B>
+class basic_solver {
+public:
+	enum result { loss = -1, unknown = 0, win = 1 };
+
+	/**
+	 * the transposition table of 2^table_bits entries is allocated by the first solve
+	 */
+	basic_solver(size_t table_bits = 20) : mask((size_t(1) << table_bits) - 1) {}
+
+	/**
+	 * solve the position for who within think_time milliseconds, and within node_limit nodes if it is not 0
+	 * return win or loss if proven, with the move to play in best
+	 */
+	result solve(const B& state, board::piece_type who, int think_time, action::place& best, size_t node_limit = 0) {
+		if (table.empty()) table.assign(mask + 1, entry());
+		deadline = clock::now() + std::chrono::milliseconds(think_time);
+		limit = node_limit;
+		nodes = 0;
+		time_up = false;
+		result res = unknown;
+		int move = -1;
+		for (int depth = 1; res == unknown && !time_up; depth++) {
+			res = search(state, who, depth, move);
+			if (depth > B::cells) break;
+		}
+		if (res != unknown) best = action::place(move, who);
+		return res;
+	}
+
+	size_t searched() const { return nodes; }
+
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct entry {
+		uint64_t key;
+		int8_t res;
+		uint8_t depth;
+		int16_t move;
+	};
+
+	result search(const B& state, board::piece_type who, int depth, int& best) {
+		if ((++nodes & 1023) == 0 && clock::now() >= deadline) time_up = true;
+		if (limit && nodes >= limit) time_up = true;
+		if (time_up) return unknown;
+
+		int moves[B::cells];
+		int count = state.legal_moves(who, moves);
+		if (count == 0) return loss;
+		if (depth == 0) return unknown;
+
+		uint64_t key = state.hash() ^ (who == board::white ? 0x5bd1e9955bd1e995ull : 0);
+		entry& e = table[key & mask];
+		if (e.key == key && (e.res != unknown || e.depth >= depth)) {
+			best = e.move;
+			return result(e.res);
+		}
+
+		// try the moves that leave the opponent the fewest legal moves first
+		board::piece_type opp = board::piece_type(3u - who);
+		std::array<std::pair<int, int>, B::cells> order;
+		std::vector<B> after(count, state);
+		for (int i = 0; i < count; i++) {
+			after[i].place(typename B::point(moves[i]), who);
+			order[i] = { after[i].legal_moves(opp) - after[i].legal_moves(who), i };
+		}
+		std::sort(order.begin(), order.begin() + count);
+
+		result res = loss;
+		best = moves[order[0].second];
+		for (int k = 0; k < count; k++) {
+			int i = order[k].second, reply;
+			result child = result(-search(after[i], opp, depth - 1, reply));
+			if (child == win) {
+				res = win;
+				best = moves[i];
+				break;
+			}
+			if (child == unknown) res = unknown;
+		}
+		if (time_up && res == unknown) return unknown;
+
+		e.key = key;
+		e.res = res;
+		e.depth = depth;
+		e.move = best;
+		return res;
+	}
+
+private:
+	std::vector<entry> table;
+	size_t mask;
+	clock::time_point deadline;
+	size_t limit;
+	size_t nodes;
+	bool time_up;
+};
+
+typedef basic_solver<board> solver;
@@ -9,13 +9,90 @@
 
 #pragma once
 #include <list>
+#include <iterator>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <string>
+#include <cstdint>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
+#include "record.h"
+#include "scheduler.h"
+
+/**
+ * log-bucketed histogram of move latencies in microseconds, with 8 buckets per power of 2,
+ * so a percentile is reported within 12.5% of the exact value
+ */
+class latency_histogram {
+public:
+	latency_histogram() : counts(16 + 8 * 60, 0), total(0), sims(0), peak(0) {}
+
+	void add(uint64_t micros, size_t simulations = 0) {
+		counts[bucket(micros)]++;
+		total++;
+		sims += simulations;
+		peak = std::max(peak, micros);
+	}
+	void merge(const latency_histogram& other) {
+		for (size_t i = 0; i < counts.size(); i++) counts[i] += other.counts[i];
+		total += other.total;
+		sims += other.sims;
+		peak = std::max(peak, other.peak);
+	}
+
+	/**
+	 * the upper bound of the latency of the p-th quantile, e.g., p = 0.99
+	 */
+	uint64_t percentile(double p) const {
+		uint64_t rank = std::max<uint64_t>(1, std::ceil(p * total)), seen = 0;
+		for (size_t i = 0; i < counts.size(); i++)
+			if ((seen += counts[i]) >= rank) return std::min(upper(i), peak);
+		return peak;
+	}
+	uint64_t max() const { return peak; }
+	uint64_t count() const { return total; }
+	double sims_per_move() const { return total ? sims * 1.0 / total : 0; }
+
+	/**
+	 * written as the count, the simulations, the max, and the nonzero buckets as index:count
+	 */
+	friend std::ostream& operator <<(std::ostream& out, const latency_histogram& h) {
+		out << h.total << ' ' << h.sims << ' ' << h.peak;
+		for (size_t i = 0; i < h.counts.size(); i++)
+			if (h.counts[i]) out << ' ' << i << ':' << h.counts[i];
+		return out;
+	}
+	friend std::istream& operator >>(std::istream& in, latency_histogram& h) {
+		h = {};
+		in >> h.total >> h.sims >> h.peak;
+		size_t i;
+		char colon;
+		while (in >> i >> colon && i < h.counts.size()) in >> h.counts[i];
+		return in;
+	}
+
+private:
+	static size_t bucket(uint64_t v) {
+		if (v < 16) return v;
+		int e = 63 - __builtin_clzll(v);
+		return std::min<size_t>(16 + (e - 4) * 8 + ((v >> (e - 3)) & 7), 16 + 8 * 60 - 1);
+	}
+	static uint64_t upper(size_t i) {
+		if (i < 16) return i;
+		int e = (i - 16) / 8 + 4;
+		return (uint64_t(8 + (i - 16) % 8 + 1) << (e - 3)) - 1;
+	}
+
+private:
+	std::vector<uint64_t> counts;
+	uint64_t total;
+	uint64_t sims;
+	uint64_t peak;
+};
 
 class statistic {
 public:
@@ -50,11 +127,18 @@ public:
 	 *                                  the average speed of white is 135377
 	 */
 	void show() const {
-		size_t blk = std::min(data.size(), block);
+		show(data.end(), count);
+	}
+
+	/**
+	 * show the statistic of the 'block' games before 'it', labeled as game n
+	 */
+	void show(std::list<episode>::const_iterator it, size_t n) const {
+		size_t blk = std::min<size_t>(std::distance(data.begin(), it), block);
 		size_t sop = 0, Bop = 0, Wop = 0;
 		time_t sdu = 0, Bdu = 0, Wdu = 0;
 		size_t BW = 0, WW = 0;
-		auto it = data.end();
+		latency_histogram Blat, Wlat;
 		for (size_t i = 0; i < blk; i++) {
 			auto& ep = *(--it);
 			if (ep.ep_moves.size() % 2 == 1) BW++;
@@ -65,9 +149,13 @@ public:
 			sdu += ep.time();
 			Bdu += ep.time(action::black::type);
 			Wdu += ep.time(action::white::type);
+			for (size_t i = 0; i < ep.ep_moves.size(); i++) {
+				if (ep.ep_moves[i].micros == 0) continue; // loaded from a record
+				(i % 2 ? Wlat : Blat).add(ep.ep_moves[i].micros, ep.ep_moves[i].sims);
+			}
 		}
 
-		std::cout << count << "\t";
+		std::cout << n << "\t";
 		std::cout << "win = " << (BW * 100.0 / blk) << "%"
 		          <<      "|" << (WW * 100.0 / blk) << "%, ";
 		std::cout << "op = "  << (sop * 1.0 / blk)
@@ -77,6 +165,20 @@ public:
 		          <<     " (" << (Bop * 1000.0 / Bdu)
 		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
 		std::cout << std::endl;
+		if (Blat.count() + Wlat.count()) show(Blat, Wlat);
+	}
+
+	/**
+	 * show the tail latencies of black|white, e.g.,
+	 * 	latency = 812|805us p50, 905|900us p90, 1203|1150us p99, 1530|1411us max, sims = 1000|1000
+	 */
+	static void show(const latency_histogram& B, const latency_histogram& W) {
+		std::cout << "\tlatency = ";
+		for (double p : { 0.5, 0.9, 0.99 })
+			std::cout << B.percentile(p) << "|" << W.percentile(p) << "us p" << int(p * 100) << ", ";
+		std::cout << B.max() << "|" << W.max() << "us max, ";
+		std::cout << "sims = " << B.sims_per_move() << "|" << W.sims_per_move();
+		std::cout << std::endl;
 	}
 
 	void summary() const {
@@ -84,12 +186,46 @@ public:
 		const_cast<statistic&>(*this).block = data.size();
 		show();
 		const_cast<statistic&>(*this).block = block_temp;
+		if (latency[0].count() + latency[1].count()) {
+			std::cout << "overall" << std::endl;
+			show(latency[0], latency[1]);
+		}
+	}
+
+	/**
+	 * show the statistic of every block of the records, e.g., after merging
+	 */
+	void show_blocks() const {
+		if (block == 0) return;
+		size_t n = count - data.size();
+		for (auto it = data.begin(); it != data.end(); ) {
+			++it;
+			if (++n % block == 0) show(it, n);
+		}
+	}
+
+	/**
+	 * merge the records of another statistic (which is left empty) into this one
+	 * the episodes are ordered by their opening time, and the counts are summed
+	 */
+	void merge(statistic& other) {
+		data.merge(other.data, [](const episode& a, const episode& b) { return a.ep_open.when < b.ep_open.when; });
+		latency[0].merge(other.latency[0]);
+		latency[1].merge(other.latency[1]);
+		other.latency[0] = other.latency[1] = {};
+		count += other.count;
+		total = std::max(total, count);
+		other.count = 0;
 	}
 
 	bool is_finished() const {
 		return count >= total;
 	}
 
+	size_t episodes() const {
+		return count;
+	}
+
 	bool is_episode_ongoing() const {
 		return data.size() && data.back().ep_close.when == 0;
 	}
@@ -102,7 +238,16 @@ public:
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
-		if (count % block == 0) show();
+		account(data.back());
+	}
+
+	/**
+	 * add an episode played elsewhere, e.g., by a worker of the scheduler, as if it is opened and closed here
+	 */
+	void add_episode(const episode& ep) {
+		if (count++ >= limit) data.pop_front();
+		data.push_back(ep);
+		account(ep);
 	}
 
 	episode& at(size_t i) {
@@ -117,12 +262,29 @@ public:
 		return data.back();
 	}
 
+	/**
+	 * the records are followed by the latency histograms of black and white, as
+	 * @latency black <histogram>
+	 * @latency white <histogram>
+	 */
 	friend std::ostream& operator <<(std::ostream& out, const statistic& stat) {
 		for (const episode& rec : stat.data) out << rec << std::endl;
+		if (stat.latency[0].count() + stat.latency[1].count()) {
+			out << "@latency black " << stat.latency[0] << std::endl;
+			out << "@latency white " << stat.latency[1] << std::endl;
+		}
 		return out;
 	}
 	friend std::istream& operator >>(std::istream& in, statistic& stat) {
 		for (std::string line; std::getline(in, line) && line.size(); ) {
+			if (line.find("@latency ") == 0) {
+				std::stringstream ss(line.substr(9));
+				std::string who;
+				latency_histogram h;
+				ss >> who >> h;
+				stat.latency[who == "white"].merge(h);
+				continue;
+			}
 			stat.data.emplace_back();
 			std::stringstream(line) >> stat.data.back();
 		}
@@ -131,10 +293,63 @@ public:
 		return in;
 	}
 
+	/**
+	 * read the records of a file as operator >>, but over the memory-mapped file without copying its lines,
+	 * where the file is split at line boundaries into a chunk per thread, parsed as tasks of the shared scheduler
+	 * return false if the file cannot be read
+	 */
+	bool load(const std::string& path, size_t threads = 1) {
+		mapped_file file(path);
+		if (!file.is_open()) return false;
+		std::vector<text_range> chunks = mapped_file::split(file.text(), std::max<size_t>(threads, 1));
+		std::vector<std::list<episode>> parts(chunks.size());
+		std::vector<latency_histogram> parts_latency(chunks.size() * 2);
+		std::vector<char> ended(chunks.size(), false); // the records end at the first empty line, as operator >>
+		auto parse = [&](size_t i) {
+			mapped_file::lines(chunks[i], [&](text_range line) {
+				if (line.empty()) {
+					ended[i] = true;
+					return false;
+				}
+				if (line.starts_with("@latency ")) {
+					std::stringstream ss(text_range(line.first + 9, line.last).str());
+					std::string who;
+					latency_histogram h;
+					ss >> who >> h;
+					parts_latency[i * 2 + (who == "white")].merge(h);
+					return true;
+				}
+				parts[i].emplace_back();
+				parts[i].back().parse(line);
+				return true;
+			});
+		};
+		if (chunks.size() > 1) scheduler::shared().parallel_for(chunks.size(), parse);
+		else if (chunks.size()) parse(0);
+
+		for (size_t i = 0; i < chunks.size(); i++) {
+			data.splice(data.end(), parts[i]);
+			latency[0].merge(parts_latency[i * 2]);
+			latency[1].merge(parts_latency[i * 2 + 1]);
+			if (ended[i]) break;
+		}
+		total = std::max(total, data.size());
+		count = data.size();
+		return true;
+	}
+
+private:
+	void account(const episode& ep) {
+		for (size_t i = 0; i < ep.ep_moves.size(); i++)
+			if (ep.ep_moves[i].micros) latency[i % 2].add(ep.ep_moves[i].micros, ep.ep_moves[i].sims);
+		if (count % block == 0) show();
+	}
+
 private:
 	size_t total;
 	size_t block;
 	size_t limit;
 	size_t count;
 	std::list<episode> data;
+	latency_histogram latency[2]; // of all moves by black and white, including the dropped records
 };
@@ -0,0 +1,297 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * suite.h: Reference positions with proven answers, and time-to-solution benchmarking of the search
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "solver.h"
+#include "scheduler.h"
+
+/**
+ * a position of the suite, written as a header line followed by a board dump as printed by board
+ *   <name> <b|w> best <move>,<move>,... [tier]     solved by playing any of the moves, i.e., the proven wins
+ *   <name> <b|w> avoid <move>,<move>,... [tier]    solved by playing none of the moves, i.e., the proven losses
+ * where b|w is the player to move, and the optional tier is the difficulty graded by suite_builder;
+ * empty lines and lines starting with # are skipped between positions
+ */
+struct suite_position {
+	std::string name;
+	board state;
+	board::piece_type who = board::black;
+	bool avoid = false;
+	std::vector<int> moves;
+	std::string tier;
+
+	bool solved_by(int move) const {
+		bool listed = std::find(moves.begin(), moves.end(), move) != moves.end();
+		return move != -1 && listed != avoid;
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const suite_position& p) {
+		out << p.name << ' ' << "?bw"[p.who] << ' ' << (p.avoid ? "avoid" : "best") << ' ';
+		for (size_t i = 0; i < p.moves.size(); i++)
+			out << (i ? "," : "") << std::string(board::point(p.moves[i]));
+		if (p.tier.size()) out << ' ' << p.tier;
+		return out << std::endl << p.state;
+	}
+	friend std::istream& operator >>(std::istream& in, suite_position& p) {
+		std::string line;
+		while (std::getline(in, line) && (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#'));
+		std::stringstream header(line);
+		std::string who, kind, moves;
+		if (!(header >> p.name >> who >> kind >> moves) || (who != "b" && who != "w") || (kind != "best" && kind != "avoid")) {
+			in.setstate(std::ios::failbit);
+			return in;
+		}
+		p.who = (who == "b") ? board::black : board::white;
+		p.avoid = (kind == "avoid");
+		if (!(header >> p.tier)) p.tier.clear();
+		p.moves.clear();
+		std::stringstream list(moves);
+		for (std::string move; std::getline(list, move, ','); ) p.moves.push_back(board::point(move).i);
+		p.state = board();
+		if (in >> p.state) p.state.info(board::data{ p.who });
+		return in;
+	}
+};
+
+/**
+ * search every position of the suite with the settings of a player, and report how many are solved,
+ * and the median time and simulations to find the correct move and keep it until the end of the search,
+ * with the positions solved per tier if the positions are graded
+ *
+ * the format would be
+ * base    solved = 23/30 (easy 10/10, medium 8/10, hard 5/10), median = 41.2ms 3100 sims, unsolved = p07 p12
+ */
+class suite_runner {
+public:
+	suite_runner(const std::vector<suite_position>& positions) : positions(positions) {}
+
+	/**
+	 * run the player args over the suite as tasks of the shared scheduler, with the engine seeded per position
+	 */
+	void run(const std::string& args, unsigned seed, std::ostream& out = std::cout) {
+		std::vector<result> results(positions.size());
+		per_worker<player> black([&]() { return new player("name=suite " + args + " role=black"); });
+		per_worker<player> white([&]() { return new player("name=suite " + args + " role=white"); });
+		scheduler::shared().parallel_for(positions.size(), [&](size_t i) {
+			const suite_position& p = positions[i];
+			player& who = p.who == board::black ? black.local() : white.local();
+			engine.seed(seed + i); // so that the result does not depend on the workers
+			std::iota(node::space().begin(), node::space().end(), 0);
+			results[i] = measure(who, p);
+		});
+
+		std::vector<double> times, sims;
+		std::string unsolved;
+		std::vector<std::string> tiers;
+		std::vector<std::pair<size_t, size_t>> tally; // solved and total per tier
+		for (size_t i = 0; i < results.size(); i++) {
+			if (results[i].solved) {
+				times.push_back(results[i].millis);
+				sims.push_back(results[i].sims);
+			} else {
+				unsolved += ' ' + positions[i].name;
+			}
+			if (positions[i].tier.empty()) continue;
+			size_t t = std::find(tiers.begin(), tiers.end(), positions[i].tier) - tiers.begin();
+			if (t == tiers.size()) {
+				tiers.push_back(positions[i].tier);
+				tally.emplace_back(0, 0);
+			}
+			tally[t].first += results[i].solved;
+			tally[t].second++;
+		}
+		out << player("name=base " + args + " role=black").name() << "\t";
+		out << "solved = " << times.size() << "/" << positions.size();
+		for (size_t t = 0; t < tiers.size(); t++)
+			out << (t ? ", " : " (") << tiers[t] << ' ' << tally[t].first << '/' << tally[t].second << (t + 1 < tiers.size() ? "" : ")");
+		if (times.size()) out << ", median = " << std::fixed << std::setprecision(1) << median(times) << "ms "
+		                      << std::setprecision(0) << median(sims) << " sims";
+		out << std::defaultfloat << std::setprecision(6);
+		if (unsolved.size()) out << ", unsolved =" << unsolved;
+		out << std::endl;
+	}
+
+public:
+	struct result {
+		bool solved = false;
+		double millis = 0; // since the correct move is kept
+		size_t sims = 0;
+	};
+
+	/**
+	 * search the position, following the most visited move every millisecond of the search
+	 */
+	static result measure(player& who, const suite_position& p) {
+		typedef std::chrono::steady_clock clock;
+		clock::time_point start = clock::now();
+		result kept;
+		bool keeping = false;
+		auto follow = [&](const mcts& tree) {
+			bool correct = p.solved_by(tree.root_node().best_action().position().i);
+			if (correct && !keeping) {
+				kept.millis = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+				kept.sims = tree.simulation_count();
+			}
+			keeping = correct;
+		};
+		size_t total = 0;
+		action::place move = who.search(p.state, [&](const mcts& tree) { total = tree.simulation_count(); }, follow, 1);
+		kept.solved = p.solved_by(move.position().i);
+		if (kept.solved && !keeping) { // the move played is not the most visited, e.g., by sequential halving
+			kept.millis = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+			kept.sims = total;
+		}
+		return kept;
+	}
+
+private:
+	static double median(std::vector<double> values) {
+		std::sort(values.begin(), values.end());
+		size_t n = values.size();
+		return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+	}
+
+private:
+	std::vector<suite_position> positions;
+};
+
+/**
+ * collect positions from self-play of the players, after a few random plies for variety, where the exact solver
+ * proves every move within the time (in milliseconds), and there are both winning and losing moves to tell apart
+ *
+ * each position is graded by a reference search (the probe, e.g., search=MCTS count=5000) as in suite_runner:
+ * a position the probe solves within 1/20 of its budget is too easy and skipped, and the others are
+ * easy (solved within 1/4 of the budget), medium (solved within the budget), or hard (not solved by the probe)
+ * since most positions are too easy, the probe runs first, and only its move is proven if it settles early
+ */
+class suite_builder {
+public:
+	suite_builder(int solve_time = 5000, int fewest = 9, int most = 14) : solve_time(solve_time), fewest(fewest), most(most) {}
+
+	void build(const std::string& path, size_t size, unsigned seed, player& black, player& white, const std::string& probe) {
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out) throw std::runtime_error("cannot write suite: " + path);
+		player probes[] = { player("name=probe " + probe + " role=black"), player("name=probe " + probe + " role=white") };
+		size_t budget = probes[0].simulation_budget();
+		if (budget == 0) throw std::invalid_argument("the probe of the suite needs a count of simulations: " + probe);
+		out << "# reference positions, proven by the exact solver, and graded by " << probe << std::endl;
+		engine.seed(seed);
+		size_t count = 0;
+		for (size_t game = 0; count < size; game++) {
+			board state;
+			suite_position p;
+			board::piece_type who = board::black;
+			for (int ply = 0; ; ply++, who = board::piece_type(3u - who)) {
+				int moves[board::cells];
+				int legal = state.legal_moves(who, moves);
+				if (legal == 0) break;
+				player& grader = probes[who == board::black ? 0 : 1];
+				if (legal >= fewest && legal <= most && !settled(grader, state, who, budget) && classify(state, who, moves, legal, p)
+						&& (p.tier = grade(grader, p, budget)).size()) {
+					p.name = "p" + std::to_string(++count);
+					out << p << std::endl;
+					std::cerr << "suite: " << count << "/" << size << ", " << p.moves.size() << " of " << legal << " moves "
+					          << (p.avoid ? "lose" : "win") << ", " << p.tier << " (game " << game + 1 << ")" << std::endl;
+					break; // one position per game
+				}
+				int pos;
+				if (ply < random_plies) {
+					pos = moves[std::uniform_int_distribution<int>(0, legal - 1)(engine)];
+				} else {
+					pos = action::place((who == board::black ? black : white).take_action(state)).position().i;
+					if (pos == -1) break;
+				}
+				state.place(board::point(pos), who);
+			}
+		}
+	}
+
+private:
+	/**
+	 * prove every move, return true if all are proven, and neither all wins nor all losses
+	 * the fewer of the winning and the losing moves are listed
+	 */
+	bool classify(const board& state, board::piece_type who, const int* moves, int legal, suite_position& p) const {
+		std::vector<int> wins, losses;
+		for (int i = 0; i < legal; i++) {
+			board after = state;
+			after.place(board::point(moves[i]), who);
+			solver endgame;
+			action::place reply;
+			switch (endgame.solve(after, board::piece_type(3u - who), solve_time, reply)) {
+				case solver::loss: wins.push_back(moves[i]); break;
+				case solver::win:  losses.push_back(moves[i]); break;
+				default: return false;
+			}
+		}
+		if (wins.empty() || losses.empty()) return false;
+		p.state = state;
+		p.state.info(board::data{ who });
+		p.who = who;
+		p.avoid = losses.size() < wins.size();
+		p.moves = p.avoid ? losses : wins;
+		return true;
+	}
+
+	/**
+	 * whether the probe keeps a move from within 1/20 of its budget, which is proven to win, i.e., it is too easy
+	 */
+	bool settled(player& probe, const board& state, board::piece_type who, size_t budget) const {
+		board before = state;
+		before.info(board::data{ who });
+		int kept = -1;
+		size_t since = 0;
+		auto follow = [&](const mcts& tree) {
+			int move = tree.root_node().best_action().position().i;
+			if (move != kept) since = tree.simulation_count();
+			kept = move;
+		};
+		std::default_random_engine saved = engine;
+		std::iota(node::space().begin(), node::space().end(), 0);
+		int move = probe.search(before, [](const mcts&) {}, follow, 1).position().i;
+		engine = saved;
+		if (move == -1 || move != kept || since >= budget / 20) return false;
+		board after = before;
+		after.place(board::point(move), who);
+		action::place reply;
+		return solver().solve(after, board::piece_type(3u - who), solve_time, reply) == solver::loss;
+	}
+
+	/**
+	 * the tier of the position by the simulations the probe takes to solve it, or empty if it is too easy
+	 */
+	static std::string grade(player& probe, const suite_position& p, size_t budget) {
+		suite_runner::result r = probe_with(probe, p);
+		if (!r.solved) return "hard";
+		if (r.sims < budget / 20) return "";
+		return r.sims < budget / 4 ? "easy" : "medium";
+	}
+
+	static suite_runner::result probe_with(player& probe, const suite_position& p) {
+		std::default_random_engine saved = engine; // so that the self-play does not depend on the probe
+		std::iota(node::space().begin(), node::space().end(), 0);
+		suite_runner::result r = suite_runner::measure(probe, p);
+		engine = saved;
+		return r;
+	}
+
+private:
+	int solve_time;
+	int fewest, most; // the range of legal moves to consider
+	static constexpr int random_plies = 6;
+};
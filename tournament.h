@@ -0,0 +1,195 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * tournament.h: Round-robin tournament of player configs with SPRT early stopping
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+
+/**
+ * sequential probability ratio test of H0: elo = elo0 against H1: elo = elo1
+ * a NoGo game has no draw, so each game is a Bernoulli trial of the expected score
+ */
+struct sprt_test {
+	double elo0 = 0, elo1 = 20;
+	double alpha = 0.05, beta = 0.05;
+
+	static double score(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+	double llr(size_t wins, size_t losses) const {
+		double p0 = score(elo0), p1 = score(elo1);
+		return wins * std::log(p1 / p0) + losses * std::log((1 - p1) / (1 - p0));
+	}
+	double lower() const { return std::log(beta / (1 - alpha)); }
+	double upper() const { return std::log((1 - beta) / alpha); }
+
+	/**
+	 * return 1 if H1 is accepted, -1 if H0 is accepted, or 0 to continue
+	 */
+	int decide(size_t wins, size_t losses) const {
+		double r = llr(wins, losses);
+		return r >= upper() ? 1 : r <= lower() ? -1 : 0;
+	}
+};
+
+/**
+ * every pair of configs plays up to 'games' games with alternating colors, stopped early by the SPRT
+ * the games run in forked worker processes, at most 'workers' at once, so that a crash loses only its game
+ */
+class tournament {
+public:
+	tournament(const std::vector<std::string>& configs, size_t games, size_t workers, unsigned seed, const sprt_test& sprt)
+		: configs(configs), games(games), workers(std::max<size_t>(workers, 1)), seed(seed), sprt(sprt) {
+		for (size_t i = 0; i < configs.size(); i++) {
+			names.push_back(player("name=p" + std::to_string(i + 1) + " " + configs[i] + " role=black").name());
+			for (size_t j = i + 1; j < configs.size(); j++) pairings.push_back({ i, j });
+		}
+	}
+
+	void run() {
+		std::map<pid_t, std::pair<size_t, bool>> running; // pid -> (pairing, first config plays black)
+		size_t next = 0, launched = 0;
+		while (true) {
+			while (running.size() < workers) { // launch the games of the undecided pairings in turn
+				size_t k = 0;
+				for (; k < pairings.size() && !schedulable(pairings[(next + k) % pairings.size()]); k++);
+				if (k == pairings.size()) break;
+				pairing& pair = pairings[(next + k) % pairings.size()];
+				next = (next + k + 1) % pairings.size();
+				bool first_black = (pair.scheduled++ % 2 == 0);
+				std::cout.flush();
+				pid_t pid = fork();
+				if (pid == 0) {
+					const std::string& b = configs[first_black ? pair.a : pair.b];
+					const std::string& w = configs[first_black ? pair.b : pair.a];
+					_exit(play_game(b, w, seed + launched * 3));
+				}
+				launched++;
+				if (pid == -1) {
+					std::cerr << "cannot fork a game" << std::endl;
+					pair.scheduled--;
+					break;
+				}
+				running[pid] = { size_t(&pair - &pairings[0]), first_black };
+			}
+			if (running.empty()) break;
+
+			int status = 0;
+			pid_t pid = wait(&status);
+			if (pid == -1 || running.count(pid) == 0) continue;
+			pairing& pair = pairings[running[pid].first];
+			bool first_black = running[pid].second;
+			running.erase(pid);
+			int winner = WIFEXITED(status) ? WEXITSTATUS(status) : 0;
+			if (winner != board::black && winner != board::white) {
+				std::cerr << names[pair.a] << " vs " << names[pair.b] << ": a game failed and is dropped" << std::endl;
+				pair.failed++;
+				continue;
+			}
+			if ((winner == board::black) == first_black) pair.wins++;
+			else pair.losses++;
+			if (pair.decision == 0 && (pair.decision = sprt.decide(pair.wins, pair.losses)) != 0) show(pair);
+			else if (pair.decision == 0 && pair.wins + pair.losses + pair.failed >= games) show(pair);
+		}
+		summary();
+	}
+
+private:
+	struct pairing {
+		size_t a, b;            // the configs, where wins and losses are of a
+		size_t wins = 0, losses = 0, failed = 0;
+		size_t scheduled = 0;
+		int decision = 0;       // of the SPRT, see sprt_test::decide()
+		pairing(size_t a, size_t b) : a(a), b(b) {}
+	};
+
+	bool schedulable(const pairing& pair) const {
+		return pair.decision == 0 && pair.scheduled < games;
+	}
+
+	/**
+	 * play a game in the worker, return the winner as the exit code
+	 */
+	static int play_game(const std::string& black_args, const std::string& white_args, unsigned seed) {
+		std::cout.rdbuf(nullptr);
+		engine.seed(seed);
+		player black("name=black " + black_args + " role=black seed=" + std::to_string(seed + 1));
+		player white("name=white " + white_args + " role=white seed=" + std::to_string(seed + 2));
+		episode game;
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (game.apply_action(move) != true) break;
+		}
+		return game.step() % 2 ? board::black : board::white;
+	}
+
+	/**
+	 * the elo difference of the score, and its 95% confidence interval
+	 */
+	static void elo(size_t wins, size_t losses, double& diff, double& margin) {
+		double n = wins + losses;
+		double s = (wins + 0.5) / (n + 1); // keep the estimate finite for a perfect score
+		double se = std::sqrt(s * (1 - s) / (n + 1));
+		auto to_elo = [](double p) { p = std::min(std::max(p, 1e-6), 1 - 1e-6); return -400 * std::log10(1 / p - 1); };
+		diff = to_elo(s);
+		margin = (to_elo(s + 1.96 * se) - to_elo(s - 1.96 * se)) / 2;
+	}
+
+	/**
+	 * show the result of a pairing, e.g.,
+	 * p1 vs p2: 34-20, elo = +91.0 +- 95.2, LLR = 2.96 [-2.94, 2.94] H1
+	 */
+	void show(const pairing& pair) const {
+		double diff, margin;
+		elo(pair.wins, pair.losses, diff, margin);
+		const char* verdict[] = { "H0", "-", "H1" };
+		std::cout << names[pair.a] << " vs " << names[pair.b] << ": " << pair.wins << "-" << pair.losses << ", "
+		          << std::fixed << std::setprecision(1) << "elo = " << std::showpos << diff << std::noshowpos
+		          << " +- " << margin << ", " << std::setprecision(2) << "LLR = " << sprt.llr(pair.wins, pair.losses)
+		          << " [" << sprt.lower() << ", " << sprt.upper() << "] " << verdict[pair.decision + 1]
+		          << std::defaultfloat << std::endl;
+	}
+
+	/**
+	 * show all pairings, and the elo of each config from its total score against the others
+	 */
+	void summary() const {
+		for (const pairing& pair : pairings) show(pair);
+		for (size_t i = 0; i < names.size(); i++) {
+			size_t wins = 0, losses = 0;
+			for (const pairing& pair : pairings) {
+				if (pair.a == i) wins += pair.wins, losses += pair.losses;
+				if (pair.b == i) wins += pair.losses, losses += pair.wins;
+			}
+			double diff, margin;
+			elo(wins, losses, diff, margin);
+			std::cout << names[i] << ": " << wins << "-" << losses << ", "
+			          << std::fixed << std::setprecision(1) << "elo = " << std::showpos << diff << std::noshowpos
+			          << " +- " << margin << std::defaultfloat << std::endl;
+		}
+	}
+
+private:
+	std::vector<std::string> configs;
+	std::vector<std::string> names;
+	std::vector<pairing> pairings;
+	size_t games;
+	size_t workers;
+	unsigned seed;
+	sprt_test sprt;
+};